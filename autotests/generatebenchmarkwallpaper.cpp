@@ -0,0 +1,137 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QImage>
+#include <QTemporaryDir>
+
+#include <KDynamicWallpaperWriter>
+#include <KSolarDynamicWallpaperMetaData>
+
+// Only a few distinct source images are generated and cycled, which keeps the temporary files
+// small. Consecutive images always differ, so the encoder still has to code every image.
+static const int s_sourceImageCount = 8;
+
+/*!
+ * Generates the source image with the specified \a index. The images are smooth gradients with
+ * some noise on top, so the encoder can't collapse them into a handful of blocks and the
+ * decoder has about as much work to do as with a photo.
+ */
+static QImage generateImage(const QSize &size, int index)
+{
+    QImage image(size, QImage::Format_RGB32);
+    const int phase = 255 * index / s_sourceImageCount;
+
+    for (int y = 0; y < size.height(); ++y) {
+        QRgb *scanLine = reinterpret_cast<QRgb *>(image.scanLine(y));
+        for (int x = 0; x < size.width(); ++x) {
+            const int noise = ((uint(x) * 2654435761u) ^ (uint(y) * 2246822519u) ^ (uint(index) * 3266489917u)) >> 28;
+            const int red = (255 * x / size.width() + phase) & 0xff;
+            const int green = (255 * y / size.height() + phase / 2) & 0xff;
+            const int blue = 255 - phase;
+            scanLine[x] = qRgb(qMin(255, red + noise), qMin(255, green + noise), qMin(255, blue + noise));
+        }
+    }
+
+    return image;
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    const QCommandLineOption pixelFormatOption(QStringLiteral("pixel-format"), QStringLiteral("The pixel format: 444, 422 or 420"), QStringLiteral("format"));
+    const QCommandLineOption depthOption(QStringLiteral("depth"), QStringLiteral("The bit depth: 8, 10 or 12"), QStringLiteral("depth"));
+    const QCommandLineOption tileRowsOption(QStringLiteral("tile-rows-log2"), QStringLiteral("The log2 of the number of tile rows"), QStringLiteral("rows"));
+    const QCommandLineOption tileColumnsOption(QStringLiteral("tile-cols-log2"), QStringLiteral("The log2 of the number of tile columns"), QStringLiteral("columns"));
+    parser.addOption(pixelFormatOption);
+    parser.addOption(depthOption);
+    parser.addOption(tileRowsOption);
+    parser.addOption(tileColumnsOption);
+    parser.addPositionalArgument(QStringLiteral("size"), QStringLiteral("The size of the images, e.g. 1920x1080"));
+    parser.addPositionalArgument(QStringLiteral("count"), QStringLiteral("The number of images"));
+    parser.addPositionalArgument(QStringLiteral("output"), QStringLiteral("The output file"));
+    parser.addHelpOption();
+    parser.process(app);
+
+    const QStringList arguments = parser.positionalArguments();
+    if (arguments.size() != 3)
+        parser.showHelp(-1);
+
+    const QStringList dimensions = arguments[0].split(QLatin1Char('x'));
+    const QSize size = dimensions.size() == 2 ? QSize(dimensions[0].toInt(), dimensions[1].toInt()) : QSize();
+    const int imageCount = arguments[1].toInt();
+    const QString fileName = arguments[2];
+    if (size.isEmpty() || imageCount <= 0) {
+        qWarning() << "Invalid size or image count";
+        return -1;
+    }
+
+    QTemporaryDir sourceDir;
+    if (!sourceDir.isValid()) {
+        qWarning() << sourceDir.errorString();
+        return -1;
+    }
+
+    QStringList sourceFileNames;
+    for (int i = 0; i < std::min(imageCount, s_sourceImageCount); ++i) {
+        const QString sourceFileName = sourceDir.filePath(QStringLiteral("%1.png").arg(i));
+        if (!generateImage(size, i).save(sourceFileName)) {
+            qWarning() << "Failed to write" << sourceFileName;
+            return -1;
+        }
+        sourceFileNames.append(sourceFileName);
+    }
+
+    QList<KDynamicWallpaperWriter::ImageView> images;
+    QList<KDynamicWallpaperMetaData> metaData;
+    for (int i = 0; i < imageCount; ++i) {
+        images.append(KDynamicWallpaperWriter::ImageView(sourceFileNames[i % sourceFileNames.size()]));
+
+        KSolarDynamicWallpaperMetaData solarMetaData;
+        solarMetaData.setIndex(i);
+        solarMetaData.setTime(qreal(i) / imageCount);
+        metaData.append(solarMetaData);
+    }
+
+    // The quality of the images doesn't matter, only their dimensions and number do.
+    KDynamicWallpaperWriter writer;
+    writer.setSpeed(10);
+    if (parser.isSet(pixelFormatOption)) {
+        const QString pixelFormat = parser.value(pixelFormatOption);
+        if (pixelFormat == QLatin1String("444")) {
+            writer.setPixelFormat(KDynamicWallpaperWriter::Yuv444Format);
+        } else if (pixelFormat == QLatin1String("422")) {
+            writer.setPixelFormat(KDynamicWallpaperWriter::Yuv422Format);
+        } else if (pixelFormat == QLatin1String("420")) {
+            writer.setPixelFormat(KDynamicWallpaperWriter::Yuv420Format);
+        } else {
+            qWarning() << "Invalid pixel format" << pixelFormat;
+            return -1;
+        }
+    }
+    if (parser.isSet(depthOption))
+        writer.setBitDepth(parser.value(depthOption).toInt());
+    if (parser.isSet(tileRowsOption))
+        writer.setTileRowsLog2(parser.value(tileRowsOption).toInt());
+    if (parser.isSet(tileColumnsOption))
+        writer.setTileColumnsLog2(parser.value(tileColumnsOption).toInt());
+    writer.setImages(images);
+    writer.setMetaData(metaData);
+
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    if (!writer.flush(fileName)) {
+        qWarning() << writer.errorString();
+        return -1;
+    }
+
+    return 0;
+}
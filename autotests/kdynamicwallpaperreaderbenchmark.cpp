@@ -0,0 +1,444 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTest>
+#include <QThread>
+
+#include <KDynamicWallpaperReader>
+#include <KSolarDynamicWallpaperMetaData>
+
+#include "kdynamicwallpaperxmp_p.h"
+
+#include <algorithm>
+#include <optional>
+
+/*!
+ * The benchmark reads the wallpapers generated by generatebenchmarkwallpaper. It's run by the
+ * benchmark target, which writes the results in a machine-readable form as well.
+ *
+ * Latencies are measured with QBENCHMARK or, where the measured operation can't be repeated
+ * on the same reader, as the median of several samples. The peak memory usage is reported by
+ * the imageMemory() benchmark as the growth of the peak resident set size while an image is
+ * read, both with the file mapped into memory and with the whole file read into a buffer the
+ * way the reader used to load files.
+ */
+class KDynamicWallpaperReaderBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void open_data();
+    void open();
+    void metaData_data();
+    void metaData();
+    void image_data();
+    void image();
+    void imageMemory_data();
+    void imageMemory();
+    void canRead_data();
+    void canRead();
+    void decodeFormat_data();
+    void decodeFormat();
+    void convert_data();
+    void convert();
+    void decodeTiles_data();
+    void decodeTiles();
+    void parseXmp_data();
+    void parseXmp();
+
+private:
+    void addWallpaperRows();
+    void addImageRows();
+
+    QFileInfoList m_wallpapers;
+    QFileInfoList m_formatWallpapers;
+    QFileInfoList m_tileWallpapers;
+};
+
+// The number of samples taken by the benchmarks that can't use QBENCHMARK.
+static const int s_sampleCount = 5;
+
+/*!
+ * Reports the median of the specified \a samples, in nanoseconds, as the benchmark result.
+ */
+static void setMedianResult(QList<qint64> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    QTest::setBenchmarkResult(samples[samples.size() / 2] / 1e6, QTest::WalltimeMilliseconds);
+}
+
+#if defined(Q_OS_LINUX)
+/*!
+ * Returns the peak resident set size of the process in bytes, or -1 if it's unknown.
+ */
+static qint64 peakResidentSetSize()
+{
+    QFile file(QStringLiteral("/proc/self/status"));
+    if (!file.open(QIODevice::ReadOnly))
+        return -1;
+
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine();
+        if (line.startsWith("VmHWM:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong() * 1024;
+    }
+    return -1;
+}
+
+/*!
+ * Resets the peak resident set size of the process to the current resident set size. Unlike
+ * getrusage(), /proc/self/status reflects the reset, so the peak can be measured per image.
+ */
+static bool resetPeakResidentSetSize()
+{
+    QFile file(QStringLiteral("/proc/self/clear_refs"));
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    return file.write("5") == 1;
+}
+#endif
+
+void KDynamicWallpaperReaderBenchmark::initTestCase()
+{
+    const QDir dataDir(QStringLiteral(BENCHMARK_DATA_DIR));
+    m_wallpapers = dataDir.entryInfoList({QStringLiteral("*.avif")}, QDir::Files, QDir::Name);
+    m_formatWallpapers = QDir(dataDir.filePath(QStringLiteral("formats"))).entryInfoList({QStringLiteral("*.avif")}, QDir::Files, QDir::Name);
+    m_tileWallpapers = QDir(dataDir.filePath(QStringLiteral("tiles"))).entryInfoList({QStringLiteral("*.avif")}, QDir::Files, QDir::Name);
+    if (m_wallpapers.isEmpty())
+        QSKIP("No benchmark wallpapers, build the benchmarkwallpapers target first");
+}
+
+void KDynamicWallpaperReaderBenchmark::addWallpaperRows()
+{
+    QTest::addColumn<QString>("fileName");
+
+    for (const QFileInfo &wallpaper : std::as_const(m_wallpapers))
+        QTest::newRow(qPrintable(wallpaper.completeBaseName())) << wallpaper.filePath();
+}
+
+void KDynamicWallpaperReaderBenchmark::addImageRows()
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<int>("imageIndex");
+
+    for (const QFileInfo &wallpaper : std::as_const(m_wallpapers)) {
+        const KDynamicWallpaperReader reader(wallpaper.filePath(), KDynamicWallpaperReader::ReadMetaDataOnly);
+        const int imageCount = reader.imageCount();
+        const QString name = wallpaper.completeBaseName();
+
+        QTest::newRow(qPrintable(name + QStringLiteral(" first"))) << wallpaper.filePath() << 0;
+        QTest::newRow(qPrintable(name + QStringLiteral(" middle"))) << wallpaper.filePath() << imageCount / 2;
+        QTest::newRow(qPrintable(name + QStringLiteral(" last"))) << wallpaper.filePath() << imageCount - 1;
+    }
+}
+
+void KDynamicWallpaperReaderBenchmark::open_data()
+{
+    addWallpaperRows();
+}
+
+void KDynamicWallpaperReaderBenchmark::open()
+{
+    QFETCH(QString, fileName);
+
+    QBENCHMARK {
+        KDynamicWallpaperReader reader(fileName);
+        QCOMPARE(reader.error(), KDynamicWallpaperReader::NoError);
+    }
+}
+
+void KDynamicWallpaperReaderBenchmark::metaData_data()
+{
+    addWallpaperRows();
+}
+
+void KDynamicWallpaperReaderBenchmark::metaData()
+{
+    QFETCH(QString, fileName);
+
+    QBENCHMARK {
+        KDynamicWallpaperReader reader(fileName, KDynamicWallpaperReader::ReadMetaDataOnly);
+        QVERIFY(!reader.metaData().isEmpty());
+    }
+}
+
+void KDynamicWallpaperReaderBenchmark::image_data()
+{
+    addImageRows();
+}
+
+void KDynamicWallpaperReaderBenchmark::image()
+{
+    QFETCH(QString, fileName);
+    QFETCH(int, imageIndex);
+
+    // The decoder keeps the most recently decoded image, so asking the same reader for the
+    // image again wouldn't decode anything. Every sample opens a new reader outside of the
+    // measured section instead, the cost of opening is measured by the open() benchmark.
+    QList<qint64> samples;
+    for (int i = 0; i < s_sampleCount; ++i) {
+        KDynamicWallpaperReader reader(fileName);
+        QCOMPARE(reader.error(), KDynamicWallpaperReader::NoError);
+
+        QElapsedTimer timer;
+        timer.start();
+        const QImage image = reader.image(imageIndex);
+        samples.append(timer.nsecsElapsed());
+        QVERIFY(!image.isNull());
+    }
+
+    setMedianResult(samples);
+}
+
+void KDynamicWallpaperReaderBenchmark::imageMemory_data()
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<int>("imageIndex");
+    QTest::addColumn<bool>("isMapped");
+
+    for (const QFileInfo &wallpaper : std::as_const(m_wallpapers)) {
+        const KDynamicWallpaperReader reader(wallpaper.filePath(), KDynamicWallpaperReader::ReadMetaDataOnly);
+        const QString name = wallpaper.completeBaseName();
+
+        for (const int imageIndex : {0, reader.imageCount() - 1}) {
+            const QString row = name + (imageIndex ? QStringLiteral(" last") : QStringLiteral(" first"));
+            QTest::newRow(qPrintable(row + QStringLiteral(" mapped"))) << wallpaper.filePath() << imageIndex << true;
+            QTest::newRow(qPrintable(row + QStringLiteral(" buffered"))) << wallpaper.filePath() << imageIndex << false;
+        }
+    }
+}
+
+void KDynamicWallpaperReaderBenchmark::imageMemory()
+{
+#if defined(Q_OS_LINUX)
+    QFETCH(QString, fileName);
+    QFETCH(int, imageIndex);
+    QFETCH(bool, isMapped);
+
+    if (!resetPeakResidentSetSize())
+        QSKIP("The peak resident set size cannot be reset");
+    const qint64 baseline = peakResidentSetSize();
+
+    {
+        KDynamicWallpaperReader reader;
+        if (isMapped) {
+            reader.setFileName(fileName);
+        } else {
+            QFile file(fileName);
+            QVERIFY(file.open(QIODevice::ReadOnly));
+            reader.setData(file.readAll());
+        }
+        QCOMPARE(reader.error(), KDynamicWallpaperReader::NoError);
+        QVERIFY(!reader.image(imageIndex).isNull());
+    }
+
+    const qint64 peak = peakResidentSetSize();
+    QVERIFY(baseline != -1 && peak != -1);
+    QTest::setBenchmarkResult(peak - baseline, QTest::BytesAllocated);
+#else
+    QSKIP("The peak resident set size can only be measured on Linux");
+#endif
+}
+
+void KDynamicWallpaperReaderBenchmark::canRead_data()
+{
+    addWallpaperRows();
+}
+
+void KDynamicWallpaperReaderBenchmark::canRead()
+{
+    QFETCH(QString, fileName);
+
+    QBENCHMARK {
+        QVERIFY(KDynamicWallpaperReader::canRead(fileName));
+    }
+}
+
+/*!
+ * Opens a reader for \a fileName with at most \a maxThreadCount threads, or the default number
+ * of threads if \a maxThreadCount is zero, and reads the first image in full size with the
+ * specified transformation \a mode. Returns the statistics of the reader, or nullopt if the
+ * image cannot be read.
+ */
+static std::optional<KDynamicWallpaperReader::Statistics> readFirstImage(const QString &fileName, int maxThreadCount, Qt::TransformationMode mode = Qt::SmoothTransformation)
+{
+    KDynamicWallpaperReader reader;
+    if (maxThreadCount)
+        reader.setMaxThreadCount(maxThreadCount);
+    reader.setFileName(fileName);
+    if (reader.error() != KDynamicWallpaperReader::NoError)
+        return std::nullopt;
+    if (reader.image(0, reader.imageSize(), mode).isNull())
+        return std::nullopt;
+    return reader.statistics();
+}
+
+void KDynamicWallpaperReaderBenchmark::decodeFormat_data()
+{
+    QTest::addColumn<QString>("fileName");
+
+    for (const QFileInfo &wallpaper : std::as_const(m_formatWallpapers))
+        QTest::newRow(qPrintable(wallpaper.completeBaseName())) << wallpaper.filePath();
+}
+
+void KDynamicWallpaperReaderBenchmark::decodeFormat()
+{
+    QFETCH(QString, fileName);
+
+    // Only the time spent in the decoder is reported, the conversion to RGB is not included.
+    QList<qint64> samples;
+    for (int i = 0; i < s_sampleCount; ++i) {
+        const auto statistics = readFirstImage(fileName, 0);
+        QVERIFY(statistics);
+        samples.append(statistics->decodeTime);
+    }
+
+    setMedianResult(samples);
+}
+
+void KDynamicWallpaperReaderBenchmark::convert_data()
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<int>("threadCount");
+    QTest::addColumn<Qt::TransformationMode>("mode");
+
+    const int threadCount = QThread::idealThreadCount();
+    const QDir formatDir(QStringLiteral(BENCHMARK_DATA_DIR "/formats"));
+    const QString yuv444 = formatDir.filePath(QStringLiteral("yuv444-8bit.avif"));
+    const QString yuv420 = formatDir.filePath(QStringLiteral("yuv420-8bit.avif"));
+    if (!QFileInfo::exists(yuv444) || !QFileInfo::exists(yuv420))
+        QSKIP("No pixel format benchmark wallpapers, build the benchmarkwallpapers target first");
+
+    // A single thread converts the whole image as one band. 4:2:0 images with bilinear chroma
+    // upsampling, i.e. smooth transformation, are always converted as one band.
+    QTest::newRow("yuv444 single band") << yuv444 << 1 << Qt::SmoothTransformation;
+    QTest::newRow("yuv444 banded") << yuv444 << threadCount << Qt::SmoothTransformation;
+    QTest::newRow("yuv420 smooth single band") << yuv420 << threadCount << Qt::SmoothTransformation;
+    QTest::newRow("yuv420 fast single band") << yuv420 << 1 << Qt::FastTransformation;
+    QTest::newRow("yuv420 fast banded") << yuv420 << threadCount << Qt::FastTransformation;
+}
+
+void KDynamicWallpaperReaderBenchmark::convert()
+{
+    QFETCH(QString, fileName);
+    QFETCH(int, threadCount);
+    QFETCH(Qt::TransformationMode, mode);
+
+    QList<qint64> samples;
+    for (int i = 0; i < s_sampleCount; ++i) {
+        const auto statistics = readFirstImage(fileName, threadCount, mode);
+        QVERIFY(statistics);
+        samples.append(statistics->conversionTime);
+    }
+
+    setMedianResult(samples);
+}
+
+void KDynamicWallpaperReaderBenchmark::decodeTiles_data()
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<int>("threadCount");
+
+    // Powers of two up to the number of cores, and the number of cores itself.
+    const int idealThreadCount = QThread::idealThreadCount();
+    QList<int> threadCounts;
+    for (int threadCount = 1; threadCount < idealThreadCount; threadCount *= 2)
+        threadCounts.append(threadCount);
+    threadCounts.append(idealThreadCount);
+
+    for (const QFileInfo &wallpaper : std::as_const(m_tileWallpapers)) {
+        for (const int threadCount : std::as_const(threadCounts))
+            QTest::addRow("%s %d threads", qPrintable(wallpaper.completeBaseName()), threadCount) << wallpaper.filePath() << threadCount;
+    }
+}
+
+void KDynamicWallpaperReaderBenchmark::decodeTiles()
+{
+    QFETCH(QString, fileName);
+    QFETCH(int, threadCount);
+
+    if (threadCount > KDynamicWallpaperReader::globalMaxThreadCount())
+        QSKIP("The global thread limit is lower than the thread count");
+
+    QList<qint64> samples;
+    for (int i = 0; i < s_sampleCount; ++i) {
+        const auto statistics = readFirstImage(fileName, threadCount);
+        QVERIFY(statistics);
+        samples.append(statistics->decodeTime);
+    }
+
+    setMedianResult(samples);
+}
+
+/*!
+ * Returns an XMP packet with \a entryCount solar metadata entries, as written by
+ * KDynamicWallpaperWriter. If \a foreignSize is not zero, the packet starts with an
+ * unrelated rdf:Description element of about that size, the way other tools may add their
+ * own metadata.
+ */
+static QByteArray createXmpPacket(int entryCount, int foreignSize)
+{
+    QJsonArray array;
+    for (int i = 0; i < entryCount; ++i) {
+        KSolarDynamicWallpaperMetaData metaData;
+        metaData.setIndex(i);
+        metaData.setTime(qreal(i) / entryCount);
+        metaData.setSolarAzimuth(360.0 * i / entryCount);
+        metaData.setSolarElevation(90.0 * i / entryCount - 45.0);
+        array.append(metaData.toJson());
+    }
+
+    QFile templateFile(QStringLiteral(":/kdynamicwallpaper/xmp/metadata.xml"));
+    if (!templateFile.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    QByteArray xmp = templateFile.readAll();
+    xmp.replace(QByteArrayLiteral("{{type}}"), QByteArrayLiteral("solar"));
+    xmp.replace(QByteArrayLiteral("{{base64}}"), QJsonDocument(array).toJson(QJsonDocument::Compact).toBase64());
+
+    if (foreignSize > 0) {
+        const QByteArray foreign = QByteArrayLiteral("<rdf:Description rdf:about=\"\" xmlns:foreign=\"http://example.org/foreign/\" foreign:data=\"")
+            + QByteArray(foreignSize, 'x') + QByteArrayLiteral("\"/>\n    ");
+        xmp.insert(xmp.indexOf("<rdf:Description"), foreign);
+    }
+
+    return xmp;
+}
+
+void KDynamicWallpaperReaderBenchmark::parseXmp_data()
+{
+    QTest::addColumn<int>("entryCount");
+    QTest::addColumn<int>("foreignSize");
+
+    for (const int entryCount : {2, 16, 64, 256})
+        QTest::addRow("%d entries", entryCount) << entryCount << 0;
+    QTest::newRow("64 entries, 64KiB of foreign metadata") << 64 << 64 * 1024;
+}
+
+void KDynamicWallpaperReaderBenchmark::parseXmp()
+{
+    QFETCH(int, entryCount);
+    QFETCH(int, foreignSize);
+
+    const QByteArray xmp = createXmpPacket(entryCount, foreignSize);
+    QVERIFY(!xmp.isEmpty());
+
+    QBENCHMARK {
+        QCOMPARE(KDynamicWallpaperXmp::parse(xmp).size(), entryCount);
+    }
+}
+
+QTEST_GUILESS_MAIN(KDynamicWallpaperReaderBenchmark)
+
+#include "kdynamicwallpaperreaderbenchmark.moc"
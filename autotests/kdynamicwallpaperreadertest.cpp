@@ -0,0 +1,111 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include <QColor>
+#include <QDebug>
+#include <QImage>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <KDynamicWallpaperReader>
+#include <KDynamicWallpaperWriter>
+#include <KSolarDynamicWallpaperMetaData>
+
+class KDynamicWallpaperReaderTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void readOutOfRange_data();
+    void readOutOfRange();
+
+private:
+    QString writeWallpaper(KDynamicWallpaperWriter::Layout layout);
+
+    QTemporaryDir m_dir;
+    QString m_sequenceFileName;
+    QString m_itemFileName;
+};
+
+static const int s_imageCount = 3;
+
+QString KDynamicWallpaperReaderTest::writeWallpaper(KDynamicWallpaperWriter::Layout layout)
+{
+    QList<KDynamicWallpaperWriter::ImageView> images;
+    QList<KDynamicWallpaperMetaData> metaData;
+    for (int i = 0; i < s_imageCount; ++i) {
+        QImage image(64, 64, QImage::Format_RGB32);
+        image.fill(QColor::fromHsv(i * 360 / s_imageCount, 255, 255));
+        images.append(KDynamicWallpaperWriter::ImageView(image, QString::number(i)));
+
+        KSolarDynamicWallpaperMetaData solarMetaData;
+        solarMetaData.setIndex(i);
+        solarMetaData.setTime(qreal(i) / s_imageCount);
+        metaData.append(solarMetaData);
+    }
+
+    KDynamicWallpaperWriter writer;
+    writer.setSpeed(10);
+    writer.setLayout(layout);
+    writer.setImages(images);
+    writer.setMetaData(metaData);
+
+    const QString fileName = m_dir.filePath(layout == KDynamicWallpaperWriter::ItemLayout ? QStringLiteral("item.avif") : QStringLiteral("sequence.avif"));
+    if (!writer.flush(fileName)) {
+        qWarning() << writer.errorString();
+        return QString();
+    }
+    return fileName;
+}
+
+void KDynamicWallpaperReaderTest::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+
+    m_sequenceFileName = writeWallpaper(KDynamicWallpaperWriter::SequenceLayout);
+    QVERIFY(!m_sequenceFileName.isEmpty());
+
+    m_itemFileName = writeWallpaper(KDynamicWallpaperWriter::ItemLayout);
+    QVERIFY(!m_itemFileName.isEmpty());
+}
+
+void KDynamicWallpaperReaderTest::readOutOfRange_data()
+{
+    QTest::addColumn<QString>("fileName");
+    QTest::addColumn<int>("imageIndex");
+
+    QTest::newRow("sequence, -1") << m_sequenceFileName << -1;
+    QTest::newRow("sequence, imageCount") << m_sequenceFileName << s_imageCount;
+    QTest::newRow("item, -1") << m_itemFileName << -1;
+    QTest::newRow("item, imageCount") << m_itemFileName << s_imageCount;
+}
+
+void KDynamicWallpaperReaderTest::readOutOfRange()
+{
+    QFETCH(QString, fileName);
+    QFETCH(int, imageIndex);
+
+    KDynamicWallpaperReader reader(fileName);
+    QCOMPARE(reader.error(), KDynamicWallpaperReader::NoError);
+    QCOMPARE(reader.imageCount(), s_imageCount);
+
+    QImage image;
+    QVERIFY(!reader.read(imageIndex, &image));
+    QVERIFY(image.isNull());
+    QCOMPARE(reader.error(), KDynamicWallpaperReader::ReadError);
+    QVERIFY(!reader.errorString().isEmpty());
+
+    QVERIFY(reader.image(imageIndex).isNull());
+
+    // A rejected index must not leave the decoder in a state that breaks subsequent reads.
+    QVERIFY(reader.read(s_imageCount - 1, &image));
+    QCOMPARE(image.size(), QSize(64, 64));
+}
+
+QTEST_GUILESS_MAIN(KDynamicWallpaperReaderTest)
+
+#include "kdynamicwallpaperreadertest.moc"
@@ -105,8 +105,9 @@ void DynamicWallpaperCrawler::visitFolder(const QString &filePath)
 void DynamicWallpaperCrawler::visitFile(const QString &filePath)
 {
     // Not every avif file is a dynamic wallpaper, we need to read the file contents to
-    // determine whether filePath actually points to a dynamic wallpaper file.
-    KDynamicWallpaperReader reader(filePath);
+    // determine whether filePath actually points to a dynamic wallpaper file. Only the metadata
+    // is needed, so there is no need to set up the decoder.
+    KDynamicWallpaperReader reader(filePath, KDynamicWallpaperReader::ReadMetaDataOnly);
     if (reader.error() == KDynamicWallpaperReader::NoError)
         Q_EMIT foundFile(filePath, token());
 }
@@ -212,7 +212,7 @@ void DynamicWallpaperHandler::reloadDescription()
 {
     const QString fileName = m_source.toLocalFile();
 
-    m_metadata = KDynamicWallpaperReader(fileName).metaData();
+    m_metadata = KDynamicWallpaperReader(fileName, KDynamicWallpaperReader::ReadMetaDataOnly).metaData();
 
     if (!m_metadata.isEmpty()) {
         setStatus(Ready);
@@ -8,6 +8,8 @@
 #include "dynamicwallpaperglobals.h"
 #include "dynamicwallpaperimagehandle.h"
 
+#include <KDynamicWallpaperDocument>
+#include <KDynamicWallpaperImageCache>
 #include <KDynamicWallpaperReader>
 
 #include <QFutureWatcher>
@@ -18,19 +20,50 @@ static DynamicWallpaperImageAsyncResult load(const QString &fileName,
                                              const QSize &requestedSize,
                                              const QQuickImageProviderOptions &options)
 {
-    const KDynamicWallpaperReader reader(fileName);
+    // The image size is needed to compute the cache key, reading it doesn't involve decoding.
+    // The documents are shared, so several images of the same wallpaper that are loaded in
+    // parallel are decoded from a single mapping of the file, which is parsed only once.
+    const KDynamicWallpaperDocument document = KDynamicWallpaperDocument::load(fileName);
+    if (!document.isValid())
+        return DynamicWallpaperImageAsyncResult(document.errorString());
+
+    QSize effectiveSize = QQuickImageProviderWithOptions::loadSize(document.imageSize(),
+                                                                   requestedSize,
+                                                                   QByteArrayLiteral("avif"),
+                                                                   options);
+
+    // With the PreserveAspectCrop fill mode, only the part of the image that has the same aspect
+    // ratio as the requested size is visible. There is no need to convert the rest of it.
+    QRect sourceRect;
+    if (options.preserveAspectRatioCrop() && requestedSize.width() > 0 && requestedSize.height() > 0) {
+        const QRect imageRect(QPoint(0, 0), document.imageSize());
+        sourceRect = QRect(QPoint(0, 0), requestedSize.scaled(imageRect.size(), Qt::KeepAspectRatio));
+        sourceRect.moveCenter(imageRect.center());
+        if (sourceRect == imageRect) {
+            sourceRect = QRect();
+        } else if (requestedSize.width() < sourceRect.width()) {
+            effectiveSize = requestedSize;
+        } else {
+            effectiveSize = sourceRect.size();
+        }
+    }
+
+    KDynamicWallpaperImageCache *cache = KDynamicWallpaperImageCache::self();
+    QImage image = cache->find(fileName, index, sourceRect, effectiveSize);
+    if (!image.isNull())
+        return DynamicWallpaperImageAsyncResult(image);
+
+    const KDynamicWallpaperReader reader(document);
     if (reader.error() != KDynamicWallpaperReader::NoError)
         return DynamicWallpaperImageAsyncResult(reader.errorString());
 
-    const QImage image = reader.image(index);
-    const QSize effectiveSize = QQuickImageProviderWithOptions::loadSize(image.size(),
-                                                                         requestedSize,
-                                                                         QByteArrayLiteral("avif"),
-                                                                         options);
+    image = reader.image(index, sourceRect, effectiveSize);
+    if (image.isNull())
+        return DynamicWallpaperImageAsyncResult(reader.errorString());
+
+    cache->insert(fileName, index, sourceRect, effectiveSize, image);
 
-    return DynamicWallpaperImageAsyncResult(image.scaled(effectiveSize,
-                                                         Qt::IgnoreAspectRatio,
-                                                         Qt::SmoothTransformation));
+    return DynamicWallpaperImageAsyncResult(image);
 }
 
 class DynamicWallpaperAsyncImageResponse : public QQuickImageResponse
@@ -496,7 +496,7 @@ void DynamicWallpaperModel::add(const QUrl &fileUrl)
             this, &DynamicWallpaperModel::handleProberFinished);
     connect(prober, &DynamicWallpaperProber::failed,
             this, &DynamicWallpaperModel::handleProberFailed);
-    prober->start(QThread::LowestPriority);
+    prober->start();
 }
 
 void DynamicWallpaperModel::handleProberFinished(const QUrl &fileUrl)
@@ -8,6 +8,7 @@
 #include "dynamicwallpaperglobals.h"
 #include "dynamicwallpaperpreviewcache.h"
 
+#include <KDynamicWallpaperImageCache>
 #include <KDynamicWallpaperReader>
 #include <KLocalizedString>
 #include <KSolarDynamicWallpaperMetaData>
@@ -118,6 +119,25 @@ static bool isDayNight(const QList<KDynamicWallpaperMetaData> &metadata)
     });
 }
 
+/*!
+ * \internal
+ *
+ * Returns the image with the specified \a index scaled to \a size, the image is looked up in
+ * the global image cache before decoding it.
+ */
+static QImage loadImage(const KDynamicWallpaperReader &reader, int index, const QSize &size)
+{
+    KDynamicWallpaperImageCache *cache = KDynamicWallpaperImageCache::self();
+
+    QImage image = cache->find(reader.fileName(), index, size);
+    if (image.isNull()) {
+        image = reader.image(index, size, Qt::FastTransformation);
+        cache->insert(reader.fileName(), index, size, image);
+    }
+
+    return image;
+}
+
 /*!
  * \internal
  *
@@ -131,7 +151,12 @@ static DynamicWallpaperImageAsyncResult makePreview(const QString &fileName, con
 
     if (preview.isNull()) {
         // The cache has no preview for the specified wallpaper yet, so generate one...
-        KDynamicWallpaperReader reader(fileName);
+        // Previews are generated in the background, leave most decoder threads to the wallpaper.
+        // No decoder is needed if the wallpaper has embedded thumbnails.
+        KDynamicWallpaperReader reader;
+        reader.setOpenMode(KDynamicWallpaperReader::ReadMetaDataOnly);
+        reader.setPriority(KDynamicWallpaperReader::LowPriority);
+        reader.setFileName(fileName);
         if (reader.error() != KDynamicWallpaperReader::NoError)
             return DynamicWallpaperImageAsyncResult(reader.errorString());
 
@@ -161,13 +186,35 @@ static DynamicWallpaperImageAsyncResult makePreview(const QString &fileName, con
             }
         }
 
-        const QImage darkImage = reader.image(darkIndex);
-        if (darkImage.isNull())
-            return DynamicWallpaperImageAsyncResult(reader.errorString());
+        QImage darkImage;
+        QImage lightImage;
 
-        const QImage lightImage = reader.image(lightIndex);
-        if (lightImage.isNull())
-            return DynamicWallpaperImageAsyncResult(reader.errorString());
+        // The full-size images are decoded only if the wallpaper has no embedded thumbnails.
+        if (reader.hasThumbnails()) {
+            darkImage = reader.thumbnail(darkIndex);
+            lightImage = reader.thumbnail(lightIndex);
+        }
+
+        if (darkImage.isNull() || lightImage.isNull()) {
+            reader.setOpenMode(KDynamicWallpaperReader::ReadImages);
+            reader.setFileName(fileName);
+            if (reader.error() != KDynamicWallpaperReader::NoError)
+                return DynamicWallpaperImageAsyncResult(reader.errorString());
+
+            // The preview cache stores images no larger than 512x512, there is no need to decode
+            // the full-size images.
+            const QSize previewSize = reader.imageSize()
+                                          .scaled(size.expandedTo(QSize(512, 512)), Qt::KeepAspectRatio)
+                                          .boundedTo(reader.imageSize());
+
+            darkImage = loadImage(reader, darkIndex, previewSize);
+            if (darkImage.isNull())
+                return DynamicWallpaperImageAsyncResult(reader.errorString());
+
+            lightImage = loadImage(reader, lightIndex, previewSize);
+            if (lightImage.isNull())
+                return DynamicWallpaperImageAsyncResult(reader.errorString());
+        }
 
         preview = blend(darkImage, lightImage, 0.5);
         DynamicWallpaperPreviewCache::store(preview, fileName);
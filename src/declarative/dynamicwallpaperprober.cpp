@@ -24,23 +24,35 @@
  * Constructs a dynamic wallpaper prober with the specified \a fileUrl and \a parent.
  */
 DynamicWallpaperProber::DynamicWallpaperProber(const QUrl &fileUrl, QObject *parent)
-    : QThread(parent)
+    : QObject(parent)
     , m_fileUrl(fileUrl)
 {
+    connect(&m_watcher, &QFutureWatcherBase::finished, this, &DynamicWallpaperProber::handleFinished);
 }
 
 /*!
- * Destructs the DynamicWallpaperProber object.
+ * Destructs the DynamicWallpaperProber object. If the file is still being probed, the
+ * pending task is canceled.
  */
 DynamicWallpaperProber::~DynamicWallpaperProber()
 {
-    wait();
+    m_watcher.disconnect(this);
+    m_watcher.cancel();
 }
 
-void DynamicWallpaperProber::run()
+/*!
+ * Starts probing the file. The metadata is read on the thread pool of the dynamic wallpaper
+ * library with low priority, so probing doesn't delay loading of the displayed wallpapers.
+ */
+void DynamicWallpaperProber::start()
+{
+    m_watcher.setFuture(KDynamicWallpaperReader::metaDataAsync(m_fileUrl.toLocalFile(),
+                                                               KDynamicWallpaperReader::LowPriority));
+}
+
+void DynamicWallpaperProber::handleFinished()
 {
-    const KDynamicWallpaperReader reader(m_fileUrl.toLocalFile());
-    if (reader.error() == KDynamicWallpaperReader::NoError)
+    if (m_watcher.future().resultCount())
         Q_EMIT finished(m_fileUrl);
     else
         Q_EMIT failed(m_fileUrl);
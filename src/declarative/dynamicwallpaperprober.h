@@ -6,10 +6,14 @@
 
 #pragma once
 
-#include <QThread>
+#include <KDynamicWallpaperMetaData>
+
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
 #include <QUrl>
 
-class DynamicWallpaperProber : public QThread
+class DynamicWallpaperProber : public QObject
 {
     Q_OBJECT
 
@@ -17,13 +21,16 @@ public:
     explicit DynamicWallpaperProber(const QUrl &fileUrl, QObject *parent = nullptr);
     ~DynamicWallpaperProber() override;
 
-protected:
-    void run() override;
+    void start();
 
 Q_SIGNALS:
     void finished(const QUrl &fileUrl);
     void failed(const QUrl &fileUrl);
 
+private Q_SLOTS:
+    void handleFinished();
+
 private:
+    QFutureWatcher<QList<KDynamicWallpaperMetaData>> m_watcher;
     QUrl m_fileUrl;
 };
@@ -0,0 +1,289 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "kdynamicwallpaperbufferpool_p.h"
+
+#include <QCoreApplication>
+#include <QTimer>
+
+#include <cstdlib>
+
+#if defined(Q_OS_UNIX)
+#include <sys/mman.h>
+#endif
+
+/*!
+ * \internal
+ * \class KDynamicWallpaperBufferPool
+ * \brief The KDynamicWallpaperBufferPool class provides a process-wide pool of frame buffers.
+ *
+ * Decoded frames are large and short-lived. Allocating them with malloc() fragments the heap,
+ * and the freed memory rarely makes it back to the system. The pool maps large buffers with
+ * mmap() instead and keeps the most recently released buffers around, so decoding a frame
+ * with the same dimensions as the previous one doesn't allocate memory at all.
+ *
+ * Idle buffers are bounded by their total size and expire after a few seconds without being
+ * reused. The expiry is checked whenever the pool is used, when trim() is called, and by a
+ * single-shot timer in the main thread, so idle buffers are freed even if no more frames are
+ * decoded.
+ */
+
+// Every buffer starts with a header that stores its size, so it can be freed without the pool.
+static const qsizetype s_headerSize = 64;
+
+// Buffers smaller than this are not worth a separate mapping.
+static const qsizetype s_mmapThreshold = 1024 * 1024;
+
+// The maximum total size of released buffers kept for reuse.
+static const qsizetype s_maxIdleBytes = 128 * 1024 * 1024;
+
+// Released buffers that are not reused within this time (in milliseconds) are freed.
+static const qint64 s_maxIdleTime = 10000;
+
+Q_GLOBAL_STATIC(KDynamicWallpaperBufferPool, s_bufferPool)
+
+KDynamicWallpaperBufferPool::~KDynamicWallpaperBufferPool()
+{
+    clear();
+}
+
+/*!
+ * Returns the global KDynamicWallpaperBufferPool object.
+ */
+KDynamicWallpaperBufferPool *KDynamicWallpaperBufferPool::self()
+{
+    return s_bufferPool;
+}
+
+static qsizetype bufferSize(const uchar *data)
+{
+    return *reinterpret_cast<const qsizetype *>(data - s_headerSize);
+}
+
+uchar *KDynamicWallpaperBufferPool::allocate(qsizetype size)
+{
+    const qsizetype totalSize = s_headerSize + size;
+
+    uchar *base = nullptr;
+#if defined(Q_OS_UNIX)
+    if (size >= s_mmapThreshold) {
+        void *mapping = mmap(nullptr, totalSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping != MAP_FAILED)
+            base = static_cast<uchar *>(mapping);
+    } else
+#endif
+    {
+        base = static_cast<uchar *>(std::malloc(totalSize));
+    }
+
+    if (!base)
+        return nullptr;
+
+    *reinterpret_cast<qsizetype *>(base) = size;
+    return base + s_headerSize;
+}
+
+void KDynamicWallpaperBufferPool::deallocate(uchar *data)
+{
+    const qsizetype size = bufferSize(data);
+    uchar *base = data - s_headerSize;
+
+#if defined(Q_OS_UNIX)
+    if (size >= s_mmapThreshold) {
+        munmap(base, s_headerSize + size);
+        return;
+    }
+#endif
+    std::free(base);
+}
+
+/*!
+ * Removes the idle buffers that have expired and returns them. The caller must hold the lock
+ * and free the returned buffers after releasing it.
+ */
+QList<uchar *> KDynamicWallpaperBufferPool::takeExpired()
+{
+    QList<uchar *> expired;
+    for (int i = m_buffers.size() - 1; i >= 0; --i) {
+        if (m_buffers[i].expiry.hasExpired()) {
+            m_idleBytes -= bufferSize(m_buffers[i].data);
+            expired.append(m_buffers.takeAt(i).data);
+        }
+    }
+    return expired;
+}
+
+/*!
+ * Expires the idle buffers in \a msecs milliseconds, unless an expiry is already scheduled. The
+ * caller must hold the lock. Without an application object, the buffers only expire when the
+ * pool is used.
+ */
+void KDynamicWallpaperBufferPool::scheduleExpiry(qint64 msecs)
+{
+    QCoreApplication *application = QCoreApplication::instance();
+    if (m_expiryScheduled || !application)
+        return;
+    m_expiryScheduled = true;
+
+    // Buffers can be released from any thread, but the timer must run in a thread with an
+    // event loop.
+    QMetaObject::invokeMethod(
+        application,
+        [msecs]() {
+            QTimer::singleShot(std::chrono::milliseconds(msecs), QCoreApplication::instance(), []() {
+                if (!s_bufferPool.isDestroyed())
+                    s_bufferPool->expire();
+            });
+        },
+        Qt::QueuedConnection);
+}
+
+/*!
+ * Frees the idle buffers that have expired and schedules the expiry of the remaining ones.
+ */
+void KDynamicWallpaperBufferPool::expire()
+{
+    QList<uchar *> expired;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_expiryScheduled = false;
+        expired = takeExpired();
+        // The buffers are appended as they are released, so the first one expires first.
+        if (!m_buffers.isEmpty())
+            scheduleExpiry(qMax<qint64>(1, m_buffers.constFirst().expiry.remainingTime()));
+    }
+
+    for (uchar *buffer : std::as_const(expired))
+        deallocate(buffer);
+}
+
+uchar *KDynamicWallpaperBufferPool::acquire(qsizetype size)
+{
+    uchar *data = nullptr;
+    QList<uchar *> expired;
+    {
+        QMutexLocker locker(&m_mutex);
+        expired = takeExpired();
+        for (int i = m_buffers.size() - 1; i >= 0; --i) {
+            if (bufferSize(m_buffers[i].data) == size) {
+                data = m_buffers.takeAt(i).data;
+                m_idleBytes -= size;
+                break;
+            }
+        }
+        ++m_liveSizes[size];
+    }
+
+    for (uchar *buffer : std::as_const(expired))
+        deallocate(buffer);
+
+    if (!data) {
+        data = allocate(size);
+        if (!data) {
+            QMutexLocker locker(&m_mutex);
+            if (--m_liveSizes[size] == 0)
+                m_liveSizes.remove(size);
+        }
+    }
+
+    return data;
+}
+
+void KDynamicWallpaperBufferPool::release(uchar *data)
+{
+    const qsizetype size = bufferSize(data);
+
+    QList<uchar *> evicted;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (--m_liveSizes[size] == 0)
+            m_liveSizes.remove(size);
+
+        evicted = takeExpired();
+        if (size <= s_maxIdleBytes) {
+            m_buffers.append(IdleBuffer{data, QDeadlineTimer(s_maxIdleTime)});
+            m_idleBytes += size;
+            scheduleExpiry(s_maxIdleTime);
+            while (m_idleBytes > s_maxIdleBytes) {
+                const IdleBuffer oldest = m_buffers.takeFirst();
+                m_idleBytes -= bufferSize(oldest.data);
+                evicted.append(oldest.data);
+            }
+        } else {
+            evicted.append(data);
+        }
+    }
+
+    for (uchar *buffer : std::as_const(evicted))
+        deallocate(buffer);
+}
+
+void KDynamicWallpaperBufferPool::cleanup(void *data)
+{
+    // Images can outlive the pool if they are destroyed at exit.
+    if (!s_bufferPool.isDestroyed())
+        s_bufferPool->release(static_cast<uchar *>(data));
+    else
+        deallocate(static_cast<uchar *>(data));
+}
+
+/*!
+ * Returns an uninitialized image with the specified \a size and \a format whose pixels are
+ * stored in a pooled buffer. The buffer returns to the pool when the image and all its
+ * copies are destroyed.
+ *
+ * Only formats with at least 32 bits per pixel are supported, so every scanline is properly
+ * aligned without padding.
+ */
+QImage KDynamicWallpaperBufferPool::createImage(const QSize &size, QImage::Format format)
+{
+    const qsizetype bytesPerLine = qsizetype(size.width()) * 4;
+    uchar *data = acquire(bytesPerLine * size.height());
+    if (!data)
+        return QImage();
+
+    return QImage(data, size.width(), size.height(), bytesPerLine, format, cleanup, data);
+}
+
+/*!
+ * Releases the idle buffers that have expired, as well as the idle buffers whose size doesn't
+ * match any image that is still alive, back to the system. The latter are left over from
+ * wallpapers that are no longer shown and are unlikely to be requested again.
+ */
+void KDynamicWallpaperBufferPool::trim()
+{
+    QList<uchar *> buffers;
+    {
+        QMutexLocker locker(&m_mutex);
+        buffers = takeExpired();
+        for (int i = m_buffers.size() - 1; i >= 0; --i) {
+            const qsizetype size = bufferSize(m_buffers[i].data);
+            if (!m_liveSizes.contains(size)) {
+                m_idleBytes -= size;
+                buffers.append(m_buffers.takeAt(i).data);
+            }
+        }
+    }
+
+    for (uchar *buffer : std::as_const(buffers))
+        deallocate(buffer);
+}
+
+/*!
+ * Releases all idle buffers back to the system.
+ */
+void KDynamicWallpaperBufferPool::clear()
+{
+    QList<IdleBuffer> buffers;
+    {
+        QMutexLocker locker(&m_mutex);
+        buffers.swap(m_buffers);
+        m_idleBytes = 0;
+    }
+
+    for (const IdleBuffer &buffer : std::as_const(buffers))
+        deallocate(buffer.data);
+}
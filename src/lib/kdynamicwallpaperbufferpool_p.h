@@ -0,0 +1,48 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <QDeadlineTimer>
+#include <QHash>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+
+class KDynamicWallpaperBufferPool
+{
+public:
+    ~KDynamicWallpaperBufferPool();
+
+    static KDynamicWallpaperBufferPool *self();
+
+    QImage createImage(const QSize &size, QImage::Format format);
+    void trim();
+    void clear();
+
+private:
+    struct IdleBuffer
+    {
+        uchar *data;
+        QDeadlineTimer expiry;
+    };
+
+    uchar *acquire(qsizetype size);
+    void release(uchar *data);
+    QList<uchar *> takeExpired();
+    void scheduleExpiry(qint64 msecs);
+    void expire();
+
+    static uchar *allocate(qsizetype size);
+    static void deallocate(uchar *data);
+    static void cleanup(void *data);
+
+    QMutex m_mutex;
+    QList<IdleBuffer> m_buffers;
+    QHash<qsizetype, int> m_liveSizes;
+    qsizetype m_idleBytes = 0;
+    bool m_expiryScheduled = false;
+};
@@ -0,0 +1,829 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "kdynamicwallpapercontainer_p.h"
+
+#include <QtEndian>
+
+#include <algorithm>
+#include <limits>
+
+/*!
+ * \class KDynamicWallpaperContainer
+ * \brief The KDynamicWallpaperContainer class provides a lightweight parser for AVIF containers.
+ *
+ * KDynamicWallpaperContainer walks the ISOBMFF boxes of a dynamic wallpaper file and extracts
+ * the XMP packet, the number of images and the image dimensions. Unlike avifDecoderParse(), it
+ * never touches the media data and never initializes an AV1 codec, which makes it suitable for
+ * quickly checking whether a file is a dynamic wallpaper.
+ */
+
+static constexpr quint32 boxType(const char (&name)[5])
+{
+    return (quint32(quint8(name[0])) << 24) | (quint32(quint8(name[1])) << 16)
+        | (quint32(quint8(name[2])) << 8) | quint32(quint8(name[3]));
+}
+
+// Boxes larger than this are not expected in the meta or the moov box of a dynamic wallpaper.
+static const qint64 s_maxBoxSize = 64 * 1024 * 1024;
+
+// The user type of the uuid box that holds dynamic wallpaper extensions, such as thumbnails.
+static const QByteArray s_extensionUserType = QByteArrayLiteral("\xc4\xe1\xb2\xa0\x5f\x3d\x4e\x8a\x9b\x6c\x2d\x7f\x0e\x1a\x3b\x58");
+
+/*!
+ * \internal
+ *
+ * Returns the header of a box with the specified \a type and the payload size \a size.
+ */
+static QByteArray createBoxHeader(quint32 type, qint64 size)
+{
+    QByteArray header(8, Qt::Uninitialized);
+    if (size + 8 <= std::numeric_limits<quint32>::max()) {
+        qToBigEndian<quint32>(size + 8, header.data());
+        qToBigEndian<quint32>(type, header.data() + 4);
+    } else {
+        header.resize(16);
+        qToBigEndian<quint32>(1, header.data());
+        qToBigEndian<quint32>(type, header.data() + 4);
+        qToBigEndian<quint64>(size + 16, header.data() + 8);
+    }
+    return header;
+}
+
+static QByteArray createBox(quint32 type, const QByteArray &payload)
+{
+    return createBoxHeader(type, payload.size()) + payload;
+}
+
+namespace
+{
+
+struct Box
+{
+    quint32 type = 0;
+    QByteArrayView payload;
+};
+
+class ByteStream
+{
+public:
+    explicit ByteStream(QByteArrayView data)
+        : m_data(data)
+    {
+    }
+
+    bool atEnd() const
+    {
+        return m_position >= m_data.size();
+    }
+
+    qsizetype remaining() const
+    {
+        return m_data.size() - m_position;
+    }
+
+    bool skip(qsizetype count)
+    {
+        if (count < 0 || count > remaining())
+            return false;
+        m_position += count;
+        return true;
+    }
+
+    template<typename T>
+    bool read(T *value)
+    {
+        if (remaining() < qsizetype(sizeof(T)))
+            return false;
+        *value = qFromBigEndian<T>(m_data.data() + m_position);
+        m_position += sizeof(T);
+        return true;
+    }
+
+    bool readUInt(int byteCount, quint64 *value)
+    {
+        switch (byteCount) {
+        case 0:
+            *value = 0;
+            return true;
+        case 4: {
+            quint32 value32;
+            if (!read(&value32))
+                return false;
+            *value = value32;
+            return true;
+        }
+        case 8:
+            return read(value);
+        default:
+            return false;
+        }
+    }
+
+    bool readFullBoxHeader(quint8 *version, quint32 *flags)
+    {
+        quint32 header;
+        if (!read(&header))
+            return false;
+        *version = header >> 24;
+        *flags = header & 0xffffff;
+        return true;
+    }
+
+    bool readString(QByteArray *string)
+    {
+        for (qsizetype i = m_position; i < m_data.size(); ++i) {
+            if (m_data[i] == '\0') {
+                *string = m_data.sliced(m_position, i - m_position).toByteArray();
+                m_position = i + 1;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool readBox(Box *box)
+    {
+        const qsizetype start = m_position;
+
+        quint32 size;
+        quint32 type;
+        if (!read(&size) || !read(&type))
+            return false;
+
+        quint64 boxSize = size;
+        if (size == 1) {
+            if (!read(&boxSize))
+                return false;
+        } else if (size == 0) {
+            boxSize = m_data.size() - start;
+        }
+
+        if (type == boxType("uuid") && !skip(16))
+            return false;
+
+        const qsizetype headerSize = m_position - start;
+        if (boxSize < quint64(headerSize) || boxSize - headerSize > quint64(remaining()))
+            return false;
+
+        box->type = type;
+        box->payload = m_data.sliced(m_position, boxSize - headerSize);
+        m_position += boxSize - headerSize;
+        return true;
+    }
+
+private:
+    QByteArrayView m_data;
+    qsizetype m_position = 0;
+};
+
+} // namespace
+
+bool KDynamicWallpaperContainer::setError(const QString &text)
+{
+    m_errorString = text;
+    return false;
+}
+
+/*!
+ * \internal
+ *
+ * Reads the header of the box that starts at \a offset in the \a device. The box must end
+ * before \a limit.
+ */
+static bool readBoxHeader(QIODevice *device, qint64 offset, qint64 limit, quint32 *type, qint64 *headerSize, qint64 *boxSize)
+{
+    if (!device->seek(offset))
+        return false;
+
+    const QByteArray header = device->read(16);
+    ByteStream stream(header);
+
+    quint32 size;
+    if (!stream.read(&size) || !stream.read(type))
+        return false;
+
+    quint64 size64 = size;
+    *headerSize = 8;
+    if (size == 1) {
+        if (!stream.read(&size64))
+            return false;
+        *headerSize = 16;
+    } else if (size == 0) {
+        size64 = limit - offset;
+    }
+
+    if (size64 < quint64(*headerSize) || size64 > quint64(limit - offset))
+        return false;
+
+    *boxSize = size64;
+    return true;
+}
+
+/*!
+ * Reads the container structure from the specified random-access \a device. Returns \c true
+ * on success; otherwise returns \c false.
+ *
+ * Only the ftyp, meta and moov boxes, the XMP packet and the headers of the extension box are
+ * read, the media data is skipped.
+ */
+bool KDynamicWallpaperContainer::read(QIODevice *device)
+{
+    if (!walk(device, false))
+        return false;
+
+    for (const Item &item : std::as_const(m_items)) {
+        if (item.type == boxType("mime") && item.contentType == "application/rdf+xml") {
+            m_xmp = readItem(device, item);
+            break;
+        }
+    }
+
+    // With the item layout, the XMP packet is stored in the extension box rather than in the
+    // primary image, so the primary image can be encoded without knowing the metadata.
+    if (m_xmp.isEmpty() && !m_xmpRange.isNull() && m_xmpRange.length <= s_maxBoxSize) {
+        if (!device->seek(m_xmpRange.offset))
+            return setError(device->errorString());
+        m_xmp = device->read(m_xmpRange.length);
+        if (m_xmp.size() != m_xmpRange.length)
+            return setError(QStringLiteral("Truncated xmpd box"));
+    }
+
+    return true;
+}
+
+/*!
+ * Reads only the location of the data in the extension box from the specified random-access
+ * \a device. Returns \c true on success; otherwise returns \c false.
+ */
+bool KDynamicWallpaperContainer::readExtensions(QIODevice *device)
+{
+    return walk(device, true);
+}
+
+bool KDynamicWallpaperContainer::walk(QIODevice *device, bool extensionsOnly)
+{
+    if (device->isSequential())
+        return setError(QStringLiteral("The device is sequential"));
+
+    const qint64 fileSize = device->size();
+    qint64 offset = 0;
+
+    while (offset < fileSize) {
+        quint32 type;
+        qint64 headerSize;
+        qint64 boxSize;
+        if (!readBoxHeader(device, offset, fileSize, &type, &headerSize, &boxSize))
+            return setError(QStringLiteral("Invalid box"));
+
+        if (offset == 0 && type != boxType("ftyp"))
+            return setError(QStringLiteral("Not an AVIF file"));
+
+        if (type == boxType("uuid")) {
+            if (!parseExtension(device, offset + headerSize, offset + boxSize))
+                return false;
+        } else if (!extensionsOnly && (type == boxType("ftyp") || type == boxType("meta") || type == boxType("moov"))) {
+            const qint64 payloadSize = boxSize - headerSize;
+            if (payloadSize > s_maxBoxSize)
+                return setError(QStringLiteral("Box is too large"));
+
+            if (!device->seek(offset + headerSize))
+                return setError(device->errorString());
+            const QByteArray payload = device->read(payloadSize);
+            if (payload.size() != payloadSize)
+                return setError(QStringLiteral("Truncated box"));
+
+            bool ok = true;
+            switch (type) {
+            case boxType("ftyp"):
+                ok = parseFileType(payload);
+                break;
+            case boxType("meta"):
+                ok = parseMeta(payload);
+                break;
+            case boxType("moov"):
+                ok = parseMovie(payload);
+                break;
+            }
+            if (!ok)
+                return false;
+        }
+
+        offset += boxSize;
+    }
+
+    if (!offset)
+        return setError(QStringLiteral("Not an AVIF file"));
+
+    return true;
+}
+
+/*!
+ * \internal
+ *
+ * Parses the uuid box whose payload spans from \a begin to \a end. Boxes that don't carry the
+ * dynamic wallpaper extension user type are ignored. Only the headers of the child boxes are
+ * read, their payloads are loaded on demand.
+ */
+bool KDynamicWallpaperContainer::parseExtension(QIODevice *device, qint64 begin, qint64 end)
+{
+    if (end - begin < 16)
+        return setError(QStringLiteral("Invalid uuid box"));
+    if (!device->seek(begin))
+        return setError(device->errorString());
+    if (device->read(16) != s_extensionUserType)
+        return true;
+
+    qint64 offset = begin + 16;
+    while (offset < end) {
+        quint32 type;
+        qint64 headerSize;
+        qint64 boxSize;
+        if (!readBoxHeader(device, offset, end, &type, &headerSize, &boxSize))
+            return setError(QStringLiteral("Invalid extension box"));
+
+        if (type == boxType("xmpd"))
+            m_xmpRange = Range{offset + headerSize, boxSize - headerSize};
+        else if (type == boxType("thmb"))
+            m_thumbnails = Range{offset + headerSize, boxSize - headerSize};
+        else if (type == boxType("frme"))
+            m_frames.append(Range{offset + headerSize, boxSize - headerSize});
+
+        offset += boxSize;
+    }
+
+    return true;
+}
+
+/*!
+ * Returns a uuid box holding the specified dynamic wallpaper \a extension. The box can be
+ * appended to an AVIF file, other readers are going to skip it.
+ */
+QByteArray KDynamicWallpaperContainer::createExtensionBox(const Extension &extension)
+{
+    QByteArray payload;
+    if (!extension.xmp.isEmpty())
+        payload += createBox(boxType("xmpd"), extension.xmp);
+    if (!extension.thumbnails.isEmpty())
+        payload += createBox(boxType("thmb"), extension.thumbnails);
+    for (const QByteArray &frame : extension.frames)
+        payload += createBox(boxType("frme"), frame);
+
+    QByteArray box;
+    box += createBoxHeader(boxType("uuid"), 16 + payload.size());
+    box += s_extensionUserType;
+    box += payload;
+    return box;
+}
+
+/*!
+ * Returns the location of the XMP packet stored in the extension box, or a null range if the
+ * XMP packet is stored in the primary image or the file has no metadata.
+ */
+KDynamicWallpaperContainer::Range KDynamicWallpaperContainer::xmpRange() const
+{
+    return m_xmpRange;
+}
+
+/*!
+ * Returns the location of the encoded thumbnails in the file, or a null range if the file
+ * contains no thumbnails.
+ */
+KDynamicWallpaperContainer::Range KDynamicWallpaperContainer::thumbnails() const
+{
+    return m_thumbnails;
+}
+
+/*!
+ * Returns the locations of the independently encoded images in the file, or an empty list if
+ * the images are stored as an image sequence.
+ *
+ * If the list is not empty, the primary image of the file is the first wallpaper image and
+ * every element of the list is a complete AVIF file with one of the following images.
+ */
+QList<KDynamicWallpaperContainer::Range> KDynamicWallpaperContainer::frames() const
+{
+    return m_frames;
+}
+
+bool KDynamicWallpaperContainer::parseFileType(QByteArrayView payload)
+{
+    ByteStream stream(payload);
+
+    quint32 majorBrand;
+    quint32 minorVersion;
+    if (!stream.read(&majorBrand) || !stream.read(&minorVersion))
+        return setError(QStringLiteral("Truncated ftyp box"));
+
+    quint32 brand = majorBrand;
+    do {
+        if (brand == boxType("avif") || brand == boxType("avis"))
+            return true;
+    } while (stream.read(&brand));
+
+    return setError(QStringLiteral("Not an AVIF file"));
+}
+
+bool KDynamicWallpaperContainer::parseMeta(QByteArrayView payload)
+{
+    ByteStream stream(payload);
+
+    quint8 version;
+    quint32 flags;
+    if (!stream.readFullBoxHeader(&version, &flags))
+        return setError(QStringLiteral("Truncated meta box"));
+
+    while (!stream.atEnd()) {
+        Box box;
+        if (!stream.readBox(&box))
+            return setError(QStringLiteral("Truncated meta box"));
+
+        switch (box.type) {
+        case boxType("pitm"): {
+            ByteStream primaryItemStream(box.payload);
+            if (!primaryItemStream.readFullBoxHeader(&version, &flags))
+                return setError(QStringLiteral("Truncated pitm box"));
+            if (version == 0) {
+                quint16 itemId;
+                if (!primaryItemStream.read(&itemId))
+                    return setError(QStringLiteral("Truncated pitm box"));
+                m_primaryItemId = itemId;
+            } else if (!primaryItemStream.read(&m_primaryItemId)) {
+                return setError(QStringLiteral("Truncated pitm box"));
+            }
+            break;
+        }
+        case boxType("iinf"):
+            if (!parseItemInfo(box.payload))
+                return false;
+            break;
+        case boxType("iloc"):
+            if (!parseItemLocation(box.payload))
+                return false;
+            break;
+        case boxType("iprp"):
+            if (!parseItemProperties(box.payload))
+                return false;
+            break;
+        case boxType("idat"):
+            m_itemData = box.payload.toByteArray();
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool KDynamicWallpaperContainer::parseItemInfo(QByteArrayView payload)
+{
+    ByteStream stream(payload);
+
+    quint8 version;
+    quint32 flags;
+    if (!stream.readFullBoxHeader(&version, &flags))
+        return setError(QStringLiteral("Truncated iinf box"));
+    if (!stream.skip(version == 0 ? 2 : 4))
+        return setError(QStringLiteral("Truncated iinf box"));
+
+    while (!stream.atEnd()) {
+        Box box;
+        if (!stream.readBox(&box))
+            return setError(QStringLiteral("Truncated iinf box"));
+        if (box.type != boxType("infe"))
+            continue;
+
+        ByteStream entryStream(box.payload);
+        if (!entryStream.readFullBoxHeader(&version, &flags))
+            return setError(QStringLiteral("Truncated infe box"));
+        if (version < 2)
+            continue;
+
+        quint32 itemId;
+        if (version == 2) {
+            quint16 itemId16;
+            if (!entryStream.read(&itemId16))
+                return setError(QStringLiteral("Truncated infe box"));
+            itemId = itemId16;
+        } else if (!entryStream.read(&itemId)) {
+            return setError(QStringLiteral("Truncated infe box"));
+        }
+
+        Item &item = m_items[itemId];
+        QByteArray itemName;
+        if (!entryStream.skip(2) || !entryStream.read(&item.type) || !entryStream.readString(&itemName))
+            return setError(QStringLiteral("Truncated infe box"));
+        if (item.type == boxType("mime") && !entryStream.readString(&item.contentType))
+            return setError(QStringLiteral("Truncated infe box"));
+    }
+
+    return true;
+}
+
+bool KDynamicWallpaperContainer::parseItemLocation(QByteArrayView payload)
+{
+    ByteStream stream(payload);
+
+    quint8 version;
+    quint32 flags;
+    quint8 sizes[2];
+    if (!stream.readFullBoxHeader(&version, &flags) || !stream.read(&sizes[0]) || !stream.read(&sizes[1]))
+        return setError(QStringLiteral("Truncated iloc box"));
+
+    const int offsetSize = sizes[0] >> 4;
+    const int lengthSize = sizes[0] & 0xf;
+    const int baseOffsetSize = sizes[1] >> 4;
+    const int indexSize = (version == 1 || version == 2) ? (sizes[1] & 0xf) : 0;
+
+    quint32 itemCount;
+    if (version < 2) {
+        quint16 itemCount16;
+        if (!stream.read(&itemCount16))
+            return setError(QStringLiteral("Truncated iloc box"));
+        itemCount = itemCount16;
+    } else if (!stream.read(&itemCount)) {
+        return setError(QStringLiteral("Truncated iloc box"));
+    }
+
+    for (quint32 i = 0; i < itemCount; ++i) {
+        quint32 itemId;
+        if (version < 2) {
+            quint16 itemId16;
+            if (!stream.read(&itemId16))
+                return setError(QStringLiteral("Truncated iloc box"));
+            itemId = itemId16;
+        } else if (!stream.read(&itemId)) {
+            return setError(QStringLiteral("Truncated iloc box"));
+        }
+
+        Item &item = m_items[itemId];
+        if (version == 1 || version == 2) {
+            quint16 constructionMethod;
+            if (!stream.read(&constructionMethod))
+                return setError(QStringLiteral("Truncated iloc box"));
+            item.constructionMethod = constructionMethod & 0xf;
+        }
+
+        quint16 extentCount;
+        if (!stream.skip(2) || !stream.readUInt(baseOffsetSize, &item.baseOffset) || !stream.read(&extentCount))
+            return setError(QStringLiteral("Truncated iloc box"));
+
+        item.extents.clear();
+        for (int j = 0; j < extentCount; ++j) {
+            quint64 extentIndex;
+            Extent extent;
+            if (!stream.readUInt(indexSize, &extentIndex)
+                || !stream.readUInt(offsetSize, &extent.offset)
+                || !stream.readUInt(lengthSize, &extent.length)) {
+                return setError(QStringLiteral("Truncated iloc box"));
+            }
+            item.extents.append(extent);
+        }
+    }
+
+    return true;
+}
+
+bool KDynamicWallpaperContainer::parseItemProperties(QByteArrayView payload)
+{
+    ByteStream stream(payload);
+
+    while (!stream.atEnd()) {
+        Box box;
+        if (!stream.readBox(&box))
+            return setError(QStringLiteral("Truncated iprp box"));
+
+        if (box.type == boxType("ipco")) {
+            ByteStream propertyStream(box.payload);
+            while (!propertyStream.atEnd()) {
+                Box propertyBox;
+                if (!propertyStream.readBox(&propertyBox))
+                    return setError(QStringLiteral("Truncated ipco box"));
+
+                Property property;
+                property.type = propertyBox.type;
+                if (propertyBox.type == boxType("ispe")) {
+                    ByteStream spatialExtentStream(propertyBox.payload);
+                    quint8 version;
+                    quint32 flags;
+                    quint32 width;
+                    quint32 height;
+                    if (!spatialExtentStream.readFullBoxHeader(&version, &flags)
+                        || !spatialExtentStream.read(&width)
+                        || !spatialExtentStream.read(&height)) {
+                        return setError(QStringLiteral("Truncated ispe box"));
+                    }
+                    property.size = QSize(width, height);
+                }
+                m_properties.append(property);
+            }
+        } else if (box.type == boxType("ipma")) {
+            ByteStream associationStream(box.payload);
+            quint8 version;
+            quint32 flags;
+            quint32 entryCount;
+            if (!associationStream.readFullBoxHeader(&version, &flags) || !associationStream.read(&entryCount))
+                return setError(QStringLiteral("Truncated ipma box"));
+
+            for (quint32 i = 0; i < entryCount; ++i) {
+                quint32 itemId;
+                if (version < 1) {
+                    quint16 itemId16;
+                    if (!associationStream.read(&itemId16))
+                        return setError(QStringLiteral("Truncated ipma box"));
+                    itemId = itemId16;
+                } else if (!associationStream.read(&itemId)) {
+                    return setError(QStringLiteral("Truncated ipma box"));
+                }
+
+                quint8 associationCount;
+                if (!associationStream.read(&associationCount))
+                    return setError(QStringLiteral("Truncated ipma box"));
+
+                Item &item = m_items[itemId];
+                for (int j = 0; j < associationCount; ++j) {
+                    int propertyIndex;
+                    if (flags & 1) {
+                        quint16 association;
+                        if (!associationStream.read(&association))
+                            return setError(QStringLiteral("Truncated ipma box"));
+                        propertyIndex = association & 0x7fff;
+                    } else {
+                        quint8 association;
+                        if (!associationStream.read(&association))
+                            return setError(QStringLiteral("Truncated ipma box"));
+                        propertyIndex = association & 0x7f;
+                    }
+                    item.properties.append(propertyIndex);
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+bool KDynamicWallpaperContainer::parseMovie(QByteArrayView payload)
+{
+    ByteStream stream(payload);
+
+    while (!stream.atEnd()) {
+        Box box;
+        if (!stream.readBox(&box))
+            return setError(QStringLiteral("Truncated moov box"));
+        if (box.type != boxType("trak"))
+            continue;
+
+        Track track;
+        if (!parseTrack(box.payload, &track))
+            return false;
+        m_tracks.append(track);
+    }
+
+    return true;
+}
+
+bool KDynamicWallpaperContainer::parseTrack(QByteArrayView payload, Track *track)
+{
+    ByteStream stream(payload);
+
+    while (!stream.atEnd()) {
+        Box box;
+        if (!stream.readBox(&box))
+            return setError(QStringLiteral("Truncated trak box"));
+
+        switch (box.type) {
+        case boxType("tkhd"): {
+            ByteStream headerStream(box.payload);
+            quint8 version;
+            quint32 flags;
+            if (!headerStream.readFullBoxHeader(&version, &flags))
+                return setError(QStringLiteral("Truncated tkhd box"));
+
+            // Skip the timestamps, the track id, the duration, the layer, the alternate group,
+            // the volume and the transformation matrix.
+            const int skipSize = (version == 1 ? 32 : 20) + 52;
+            quint32 width;
+            quint32 height;
+            if (!headerStream.skip(skipSize) || !headerStream.read(&width) || !headerStream.read(&height))
+                return setError(QStringLiteral("Truncated tkhd box"));
+            track->size = QSize(width >> 16, height >> 16);
+            break;
+        }
+        case boxType("mdia"):
+        case boxType("minf"):
+        case boxType("stbl"):
+            if (!parseTrack(box.payload, track))
+                return false;
+            break;
+        case boxType("hdlr"): {
+            ByteStream handlerStream(box.payload);
+            quint8 version;
+            quint32 flags;
+            if (!handlerStream.readFullBoxHeader(&version, &flags) || !handlerStream.skip(4) || !handlerStream.read(&track->handler))
+                return setError(QStringLiteral("Truncated hdlr box"));
+            break;
+        }
+        case boxType("stsz"): {
+            ByteStream sampleSizeStream(box.payload);
+            quint8 version;
+            quint32 flags;
+            quint32 sampleCount;
+            if (!sampleSizeStream.readFullBoxHeader(&version, &flags) || !sampleSizeStream.skip(4) || !sampleSizeStream.read(&sampleCount))
+                return setError(QStringLiteral("Truncated stsz box"));
+            track->sampleCount = sampleCount;
+            break;
+        }
+        }
+    }
+
+    return true;
+}
+
+QByteArray KDynamicWallpaperContainer::readItem(QIODevice *device, const Item &item)
+{
+    QByteArray data;
+
+    for (const Extent &extent : item.extents) {
+        const quint64 offset = item.baseOffset + extent.offset;
+
+        if (item.constructionMethod == 0) {
+            if (!device->seek(offset))
+                return QByteArray();
+            const qint64 length = extent.length ? qint64(extent.length) : device->size() - qint64(offset);
+            if (length > s_maxBoxSize)
+                return QByteArray();
+            data += device->read(length);
+        } else if (item.constructionMethod == 1) {
+            if (offset > quint64(m_itemData.size()))
+                return QByteArray();
+            const quint64 available = m_itemData.size() - offset;
+            const quint64 length = extent.length ? std::min(extent.length, available) : available;
+            data += QByteArrayView(m_itemData).sliced(qsizetype(offset), qsizetype(length));
+        } else {
+            return QByteArray();
+        }
+    }
+
+    return data;
+}
+
+/*!
+ * Returns the XMP packet stored in the container, or an empty QByteArray if there is none.
+ * The packet is taken from the primary image or, failing that, from the extension box.
+ */
+QByteArray KDynamicWallpaperContainer::xmp() const
+{
+    return m_xmp;
+}
+
+/*!
+ * Returns the dimensions of the images stored in the container.
+ */
+QSize KDynamicWallpaperContainer::imageSize() const
+{
+    for (const Track &track : m_tracks) {
+        if (track.handler == boxType("pict"))
+            return track.size;
+    }
+
+    const auto primaryItem = m_items.constFind(m_primaryItemId);
+    if (primaryItem != m_items.constEnd()) {
+        for (int propertyIndex : primaryItem->properties) {
+            // Property indices are 1-based, 0 means that there is no associated property.
+            if (propertyIndex < 1 || propertyIndex > m_properties.size())
+                continue;
+            const Property &property = m_properties[propertyIndex - 1];
+            if (property.type == boxType("ispe"))
+                return property.size;
+        }
+    }
+
+    return QSize();
+}
+
+/*!
+ * Returns the total number of images stored in the container.
+ */
+int KDynamicWallpaperContainer::imageCount() const
+{
+    if (!m_frames.isEmpty())
+        return m_items.contains(m_primaryItemId) ? m_frames.size() + 1 : 0;
+
+    for (const Track &track : m_tracks) {
+        if (track.handler == boxType("pict"))
+            return track.sampleCount;
+    }
+
+    return m_items.contains(m_primaryItemId) ? 1 : 0;
+}
+
+/*!
+ * Returns the human readable description of the last error that occurred.
+ */
+QString KDynamicWallpaperContainer::errorString() const
+{
+    return m_errorString;
+}
@@ -0,0 +1,103 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QIODevice>
+#include <QList>
+#include <QSize>
+
+class KDynamicWallpaperContainer
+{
+public:
+    struct Range
+    {
+        qint64 offset = 0;
+        qint64 length = 0;
+
+        bool isNull() const
+        {
+            return length == 0;
+        }
+    };
+
+    struct Extension
+    {
+        QByteArray xmp;
+        QByteArray thumbnails;
+        QList<QByteArray> frames;
+    };
+
+    bool read(QIODevice *device);
+    bool readExtensions(QIODevice *device);
+
+    Range xmpRange() const;
+    Range thumbnails() const;
+    QList<Range> frames() const;
+
+    QByteArray xmp() const;
+    QSize imageSize() const;
+    int imageCount() const;
+
+    QString errorString() const;
+
+    static QByteArray createExtensionBox(const Extension &extension);
+
+private:
+    struct Extent
+    {
+        quint64 offset = 0;
+        quint64 length = 0;
+    };
+
+    struct Item
+    {
+        quint32 type = 0;
+        QByteArray contentType;
+        int constructionMethod = 0;
+        quint64 baseOffset = 0;
+        QList<Extent> extents;
+        QList<int> properties;
+    };
+
+    struct Property
+    {
+        quint32 type = 0;
+        QSize size;
+    };
+
+    struct Track
+    {
+        quint32 handler = 0;
+        QSize size;
+        int sampleCount = 0;
+    };
+
+    bool setError(const QString &text);
+    bool walk(QIODevice *device, bool extensionsOnly);
+    bool parseExtension(QIODevice *device, qint64 begin, qint64 end);
+    bool parseFileType(QByteArrayView payload);
+    bool parseMeta(QByteArrayView payload);
+    bool parseItemInfo(QByteArrayView payload);
+    bool parseItemLocation(QByteArrayView payload);
+    bool parseItemProperties(QByteArrayView payload);
+    bool parseMovie(QByteArrayView payload);
+    bool parseTrack(QByteArrayView payload, Track *track);
+    QByteArray readItem(QIODevice *device, const Item &item);
+
+    QHash<quint32, Item> m_items;
+    QList<Property> m_properties;
+    QList<Track> m_tracks;
+    QByteArray m_itemData;
+    QByteArray m_xmp;
+    QString m_errorString;
+    Range m_xmpRange;
+    Range m_thumbnails;
+    QList<Range> m_frames;
+    quint32 m_primaryItemId = 0;
+};
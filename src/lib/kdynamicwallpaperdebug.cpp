@@ -0,0 +1,9 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "kdynamicwallpaperdebug_p.h"
+
+Q_LOGGING_CATEGORY(KDYNAMICWALLPAPER, "kdynamicwallpaper", QtWarningMsg)
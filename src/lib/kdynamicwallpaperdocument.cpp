@@ -0,0 +1,261 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "kdynamicwallpaperdocument.h"
+#include "kdynamicwallpapercontainer_p.h"
+#include "kdynamicwallpaperfilekey_p.h"
+#include "kdynamicwallpaperxmp_p.h"
+
+#include <QBuffer>
+#include <QCache>
+#include <QFile>
+#include <QMutex>
+
+/*!
+ * \class KDynamicWallpaperDocument
+ * \brief The KDynamicWallpaperDocument class provides an immutable, parsed dynamic wallpaper.
+ *
+ * KDynamicWallpaperDocument maps a dynamic wallpaper file into memory and parses its container
+ * and its metadata once. The document is implicitly shared and never modified after it has
+ * been constructed, so copies of it can be passed to other threads freely.
+ *
+ * Images are decoded by KDynamicWallpaperReader objects constructed from the document. Such
+ * readers don't perform any I/O and don't parse the metadata again, they only create their
+ * own AV1 decoder. Use one reader per thread in order to decode several images of the same
+ * wallpaper in parallel.
+ */
+
+class KDynamicWallpaperDocumentPrivate : public QSharedData
+{
+public:
+    ~KDynamicWallpaperDocumentPrivate();
+
+    bool load(const QString &fileName);
+    bool parse();
+
+    QFile file;
+    KDynamicWallpaperFileKey fileKey;
+    QByteArray data;
+    uchar *mapping = nullptr;
+    QList<KDynamicWallpaperMetaData> metaData;
+    QSize imageSize;
+    int imageCount = 0;
+    QString errorString;
+};
+
+KDynamicWallpaperDocumentPrivate::~KDynamicWallpaperDocumentPrivate()
+{
+    // The mapping must outlive every QByteArray that references it.
+    data.clear();
+    if (mapping)
+        file.unmap(mapping);
+}
+
+bool KDynamicWallpaperDocumentPrivate::load(const QString &fileName)
+{
+    fileKey = KDynamicWallpaperFileKey::fromFileName(fileName);
+
+    file.setFileName(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorString = file.errorString();
+        return false;
+    }
+
+    const qint64 size = file.size();
+    if (size > 0)
+        mapping = file.map(0, size);
+
+    if (mapping)
+        data = QByteArray::fromRawData(reinterpret_cast<const char *>(mapping), size);
+    else
+        data = file.readAll();
+
+    return parse();
+}
+
+bool KDynamicWallpaperDocumentPrivate::parse()
+{
+    QBuffer buffer(&data);
+    buffer.open(QIODevice::ReadOnly);
+
+    KDynamicWallpaperContainer container;
+    if (!container.read(&buffer)) {
+        errorString = container.errorString();
+        return false;
+    }
+
+    metaData = KDynamicWallpaperXmp::parse(container.xmp());
+    if (metaData.isEmpty()) {
+        errorString = QStringLiteral("No metadata");
+        return false;
+    }
+
+    imageCount = container.imageCount();
+    imageSize = container.imageSize();
+    return true;
+}
+
+struct KDynamicWallpaperDocumentCache
+{
+    QMutex mutex;
+    // Only a couple of wallpapers are usually displayed at the same time.
+    QCache<QString, KDynamicWallpaperDocument> documents{4};
+};
+
+Q_GLOBAL_STATIC(KDynamicWallpaperDocumentCache, s_documentCache)
+
+/*!
+ * Constructs a null KDynamicWallpaperDocument object.
+ */
+KDynamicWallpaperDocument::KDynamicWallpaperDocument()
+{
+}
+
+/*!
+ * Constructs a KDynamicWallpaperDocument object for the wallpaper file \p fileName. The file
+ * is mapped into memory if possible.
+ *
+ * If the file cannot be read or it's not a dynamic wallpaper, isValid() will return \c false
+ * and errorString() will describe what went wrong.
+ */
+KDynamicWallpaperDocument::KDynamicWallpaperDocument(const QString &fileName)
+    : d(new KDynamicWallpaperDocumentPrivate)
+{
+    d->load(fileName);
+}
+
+/*!
+ * Constructs a KDynamicWallpaperDocument object for the wallpaper encoded in \p data.
+ */
+KDynamicWallpaperDocument::KDynamicWallpaperDocument(const QByteArray &data)
+    : d(new KDynamicWallpaperDocumentPrivate)
+{
+    d->data = data;
+    d->parse();
+}
+
+/*!
+ * Constructs a copy of the KDynamicWallpaperDocument object \p other.
+ */
+KDynamicWallpaperDocument::KDynamicWallpaperDocument(const KDynamicWallpaperDocument &other)
+    : d(other.d)
+{
+}
+
+/*!
+ * Destructs the KDynamicWallpaperDocument object.
+ */
+KDynamicWallpaperDocument::~KDynamicWallpaperDocument()
+{
+}
+
+KDynamicWallpaperDocument &KDynamicWallpaperDocument::operator=(const KDynamicWallpaperDocument &other)
+{
+    d = other.d;
+    return *this;
+}
+
+/*!
+ * Returns \c true if the document has been default constructed; otherwise returns \c false.
+ */
+bool KDynamicWallpaperDocument::isNull() const
+{
+    return !d;
+}
+
+/*!
+ * Returns \c true if the document holds a successfully parsed dynamic wallpaper; otherwise
+ * returns \c false.
+ */
+bool KDynamicWallpaperDocument::isValid() const
+{
+    return d && d->errorString.isEmpty();
+}
+
+/*!
+ * Returns \c true if the wallpaper file has been modified or replaced since the document was
+ * constructed; otherwise returns \c false. Stale documents should be discarded.
+ */
+bool KDynamicWallpaperDocument::isStale() const
+{
+    if (!d || !d->fileKey.isValid())
+        return false;
+    return !(KDynamicWallpaperFileKey::fromFileName(d->file.fileName()) == d->fileKey);
+}
+
+/*!
+ * Returns the name of the wallpaper file, or an empty string if the document has been
+ * constructed from a QByteArray.
+ */
+QString KDynamicWallpaperDocument::fileName() const
+{
+    return d ? d->file.fileName() : QString();
+}
+
+/*!
+ * Returns the encoded wallpaper. If the wallpaper file is mapped into memory, the returned
+ * QByteArray references the mapping and it's valid only as long as the document exists.
+ */
+QByteArray KDynamicWallpaperDocument::data() const
+{
+    return d ? d->data : QByteArray();
+}
+
+/*!
+ * Returns the KDynamicWallpaperMetaData objects for the wallpaper.
+ */
+QList<KDynamicWallpaperMetaData> KDynamicWallpaperDocument::metaData() const
+{
+    return d ? d->metaData : QList<KDynamicWallpaperMetaData>();
+}
+
+/*!
+ * Returns the total number of images in the wallpaper.
+ */
+int KDynamicWallpaperDocument::imageCount() const
+{
+    return d ? d->imageCount : 0;
+}
+
+/*!
+ * Returns the dimensions of the images in the wallpaper.
+ */
+QSize KDynamicWallpaperDocument::imageSize() const
+{
+    return d ? d->imageSize : QSize();
+}
+
+/*!
+ * Returns the document for the wallpaper file \p fileName. The most recently loaded documents
+ * are shared within the process, so the file is mapped and parsed only once no matter how many
+ * threads need it. If the file has been modified since it was loaded, it's loaded again.
+ *
+ * This function is thread-safe.
+ */
+KDynamicWallpaperDocument KDynamicWallpaperDocument::load(const QString &fileName)
+{
+    QMutexLocker locker(&s_documentCache->mutex);
+    if (const KDynamicWallpaperDocument *document = s_documentCache->documents.object(fileName)) {
+        if (!document->isStale())
+            return *document;
+    }
+
+    const KDynamicWallpaperDocument document(fileName);
+    if (document.isValid())
+        s_documentCache->documents.insert(fileName, new KDynamicWallpaperDocument(document));
+    else
+        s_documentCache->documents.remove(fileName);
+    return document;
+}
+
+/*!
+ * Returns the human readable description of the error that occurred when loading the
+ * wallpaper, or an empty string if there was no error.
+ */
+QString KDynamicWallpaperDocument::errorString() const
+{
+    return d ? d->errorString : QString();
+}
@@ -0,0 +1,46 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "kdynamicwallpaper_export.h"
+#include "kdynamicwallpapermetadata.h"
+
+#include <QByteArray>
+#include <QSharedDataPointer>
+#include <QSize>
+
+class KDynamicWallpaperDocumentPrivate;
+
+class KDYNAMICWALLPAPER_EXPORT KDynamicWallpaperDocument
+{
+public:
+    KDynamicWallpaperDocument();
+    explicit KDynamicWallpaperDocument(const QString &fileName);
+    explicit KDynamicWallpaperDocument(const QByteArray &data);
+    KDynamicWallpaperDocument(const KDynamicWallpaperDocument &other);
+    ~KDynamicWallpaperDocument();
+
+    KDynamicWallpaperDocument &operator=(const KDynamicWallpaperDocument &other);
+
+    bool isNull() const;
+    bool isValid() const;
+    bool isStale() const;
+
+    QString fileName() const;
+    QByteArray data() const;
+
+    QList<KDynamicWallpaperMetaData> metaData() const;
+    int imageCount() const;
+    QSize imageSize() const;
+
+    QString errorString() const;
+
+    static KDynamicWallpaperDocument load(const QString &fileName);
+
+private:
+    QExplicitlySharedDataPointer<KDynamicWallpaperDocumentPrivate> d;
+};
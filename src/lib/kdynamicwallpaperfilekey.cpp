@@ -0,0 +1,70 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "kdynamicwallpaperfilekey_p.h"
+
+#include <QDateTime>
+#include <QFileInfo>
+
+#if defined(Q_OS_LINUX)
+#include <sys/stat.h>
+#endif
+
+/*!
+ * \class KDynamicWallpaperFileKey
+ * \brief The KDynamicWallpaperFileKey class identifies a particular version of a file.
+ *
+ * The key consists of the canonical file path, the modification time, the file size and the
+ * inode number, so it changes whenever the file is modified or replaced.
+ */
+
+/*!
+ * Returns the key for the file with the specified \a fileName. If the file does not exist,
+ * an invalid key is returned.
+ */
+KDynamicWallpaperFileKey KDynamicWallpaperFileKey::fromFileName(const QString &fileName)
+{
+    const QFileInfo fileInfo(fileName);
+
+    KDynamicWallpaperFileKey key;
+    key.filePath = fileInfo.canonicalFilePath();
+    if (key.filePath.isEmpty())
+        return key;
+
+#if defined(Q_OS_LINUX)
+    struct stat buffer;
+    if (stat(QFile::encodeName(key.filePath).constData(), &buffer) != 0)
+        return KDynamicWallpaperFileKey();
+
+    key.lastModified = qint64(buffer.st_mtim.tv_sec) * 1000 + buffer.st_mtim.tv_nsec / 1000000;
+    key.size = buffer.st_size;
+    key.inode = buffer.st_ino;
+#else
+    key.lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+    key.size = fileInfo.size();
+#endif
+
+    return key;
+}
+
+/*!
+ * Returns \c true if the key refers to an existing file; otherwise returns \c false.
+ */
+bool KDynamicWallpaperFileKey::isValid() const
+{
+    return !filePath.isEmpty();
+}
+
+bool operator==(const KDynamicWallpaperFileKey &a, const KDynamicWallpaperFileKey &b)
+{
+    return a.filePath == b.filePath && a.lastModified == b.lastModified
+        && a.size == b.size && a.inode == b.inode;
+}
+
+size_t qHash(const KDynamicWallpaperFileKey &key, size_t seed)
+{
+    return qHashMulti(seed, key.filePath, key.lastModified, key.size, key.inode);
+}
@@ -0,0 +1,26 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <QHashFunctions>
+#include <QString>
+
+class KDynamicWallpaperFileKey
+{
+public:
+    static KDynamicWallpaperFileKey fromFileName(const QString &fileName);
+
+    bool isValid() const;
+
+    QString filePath;
+    qint64 lastModified = 0;
+    qint64 size = 0;
+    quint64 inode = 0;
+};
+
+bool operator==(const KDynamicWallpaperFileKey &a, const KDynamicWallpaperFileKey &b);
+size_t qHash(const KDynamicWallpaperFileKey &key, size_t seed = 0);
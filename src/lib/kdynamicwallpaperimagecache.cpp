@@ -0,0 +1,196 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "kdynamicwallpaperimagecache.h"
+#include "kdynamicwallpaperfilekey_p.h"
+
+#include <QCache>
+#include <QMutex>
+
+/*!
+ * \class KDynamicWallpaperImageCache
+ * \brief The KDynamicWallpaperImageCache class provides a process-wide cache of decoded
+ * wallpaper images.
+ *
+ * Decoding an image of a dynamic wallpaper is expensive, so images that have already been
+ * decoded and scaled are kept in a least recently used cache. Images are identified by the
+ * file they have been decoded from, the image index, the source rectangle and the size of
+ * the image. If the file
+ * is modified or replaced, the cached images are not going to be returned anymore.
+ *
+ * The total size of the cached images is limited by maxCost(), in bytes.
+ *
+ * All methods of the KDynamicWallpaperImageCache class are thread-safe.
+ */
+
+struct KDynamicWallpaperImageCacheKey
+{
+    KDynamicWallpaperFileKey file;
+    int imageIndex;
+    QRect sourceRect;
+    QSize size;
+};
+
+static bool operator==(const KDynamicWallpaperImageCacheKey &a, const KDynamicWallpaperImageCacheKey &b)
+{
+    return a.file == b.file && a.imageIndex == b.imageIndex && a.sourceRect == b.sourceRect && a.size == b.size;
+}
+
+static size_t qHash(const KDynamicWallpaperImageCacheKey &key, size_t seed = 0)
+{
+    return qHashMulti(seed, key.file, key.imageIndex, key.sourceRect.x(), key.sourceRect.y(), key.sourceRect.width(),
+                      key.sourceRect.height(), key.size.width(), key.size.height());
+}
+
+class KDynamicWallpaperImageCachePrivate
+{
+public:
+    mutable QMutex mutex;
+    QCache<KDynamicWallpaperImageCacheKey, QImage> images;
+    qint64 hitCount = 0;
+    qint64 missCount = 0;
+};
+
+class KDynamicWallpaperImageCacheSingleton
+{
+public:
+    KDynamicWallpaperImageCache self;
+};
+
+Q_GLOBAL_STATIC(KDynamicWallpaperImageCacheSingleton, s_imageCache)
+
+// Enough to hold a couple of 4K images.
+static const qint64 s_defaultMaxCost = 128 * 1024 * 1024;
+
+KDynamicWallpaperImageCache::KDynamicWallpaperImageCache()
+    : d(new KDynamicWallpaperImageCachePrivate)
+{
+    d->images.setMaxCost(s_defaultMaxCost);
+}
+
+KDynamicWallpaperImageCache::~KDynamicWallpaperImageCache()
+{
+}
+
+/*!
+ * Returns the global KDynamicWallpaperImageCache object.
+ */
+KDynamicWallpaperImageCache *KDynamicWallpaperImageCache::self()
+{
+    return &s_imageCache->self;
+}
+
+/*!
+ * Returns the cached image with the specified \a imageIndex and \a size decoded from the file
+ * \a fileName. If there is no such image in the cache, a null QImage object is returned.
+ */
+QImage KDynamicWallpaperImageCache::find(const QString &fileName, int imageIndex, const QSize &size) const
+{
+    return find(fileName, imageIndex, QRect(), size);
+}
+
+/*!
+ * Returns the cached area \a sourceRect of the image with the specified \a imageIndex scaled to
+ * \a size decoded from the file \a fileName. A null \a sourceRect refers to the whole image. If
+ * there is no such image in the cache, a null QImage object is returned.
+ */
+QImage KDynamicWallpaperImageCache::find(const QString &fileName, int imageIndex, const QRect &sourceRect, const QSize &size) const
+{
+    const KDynamicWallpaperFileKey file = KDynamicWallpaperFileKey::fromFileName(fileName);
+    if (!file.isValid())
+        return QImage();
+
+    QMutexLocker locker(&d->mutex);
+    if (const QImage *image = d->images.object(KDynamicWallpaperImageCacheKey{file, imageIndex, sourceRect, size})) {
+        ++d->hitCount;
+        return *image;
+    }
+
+    ++d->missCount;
+    return QImage();
+}
+
+/*!
+ * Inserts the \a image with the specified \a imageIndex and \a size decoded from the file
+ * \a fileName in the cache. Images that are larger than maxCost() are not cached.
+ */
+void KDynamicWallpaperImageCache::insert(const QString &fileName, int imageIndex, const QSize &size, const QImage &image)
+{
+    insert(fileName, imageIndex, QRect(), size, image);
+}
+
+/*!
+ * Inserts the area \a sourceRect of the image with the specified \a imageIndex scaled to \a size
+ * decoded from the file \a fileName in the cache. Images that are larger than maxCost() are
+ * not cached.
+ */
+void KDynamicWallpaperImageCache::insert(const QString &fileName, int imageIndex, const QRect &sourceRect, const QSize &size, const QImage &image)
+{
+    if (image.isNull())
+        return;
+
+    const KDynamicWallpaperFileKey file = KDynamicWallpaperFileKey::fromFileName(fileName);
+    if (!file.isValid())
+        return;
+
+    QMutexLocker locker(&d->mutex);
+    d->images.insert(KDynamicWallpaperImageCacheKey{file, imageIndex, sourceRect, size}, new QImage(image), image.sizeInBytes());
+}
+
+/*!
+ * Removes all images from the cache.
+ */
+void KDynamicWallpaperImageCache::clear()
+{
+    QMutexLocker locker(&d->mutex);
+    d->images.clear();
+}
+
+/*!
+ * Sets the maximum total size of the cached images to \a bytes. If the cache holds more
+ * than \a bytes, the least recently used images will be evicted.
+ */
+void KDynamicWallpaperImageCache::setMaxCost(qint64 bytes)
+{
+    QMutexLocker locker(&d->mutex);
+    d->images.setMaxCost(bytes);
+}
+
+/*!
+ * Returns the maximum total size of the cached images, in bytes. The default is 128 MiB.
+ */
+qint64 KDynamicWallpaperImageCache::maxCost() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->images.maxCost();
+}
+
+/*!
+ * Returns the total size of the cached images, in bytes.
+ */
+qint64 KDynamicWallpaperImageCache::totalCost() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->images.totalCost();
+}
+
+/*!
+ * Returns the number of lookups that have found an image in the cache.
+ */
+qint64 KDynamicWallpaperImageCache::hitCount() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->hitCount;
+}
+
+/*!
+ * Returns the number of lookups that have not found an image in the cache.
+ */
+qint64 KDynamicWallpaperImageCache::missCount() const
+{
+    QMutexLocker locker(&d->mutex);
+    return d->missCount;
+}
@@ -0,0 +1,42 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "kdynamicwallpaper_export.h"
+
+#include <QImage>
+#include <QRect>
+#include <QSize>
+#include <QString>
+
+class KDynamicWallpaperImageCachePrivate;
+
+class KDYNAMICWALLPAPER_EXPORT KDynamicWallpaperImageCache
+{
+public:
+    static KDynamicWallpaperImageCache *self();
+
+    QImage find(const QString &fileName, int imageIndex, const QSize &size) const;
+    QImage find(const QString &fileName, int imageIndex, const QRect &sourceRect, const QSize &size) const;
+    void insert(const QString &fileName, int imageIndex, const QSize &size, const QImage &image);
+    void insert(const QString &fileName, int imageIndex, const QRect &sourceRect, const QSize &size, const QImage &image);
+    void clear();
+
+    void setMaxCost(qint64 bytes);
+    qint64 maxCost() const;
+    qint64 totalCost() const;
+
+    qint64 hitCount() const;
+    qint64 missCount() const;
+
+private:
+    KDynamicWallpaperImageCache();
+    ~KDynamicWallpaperImageCache();
+
+    QScopedPointer<KDynamicWallpaperImageCachePrivate> d;
+    friend class KDynamicWallpaperImageCacheSingleton;
+};
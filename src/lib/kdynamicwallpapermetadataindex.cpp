@@ -0,0 +1,165 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "kdynamicwallpapermetadataindex_p.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+/*!
+ * \class KDynamicWallpaperMetaDataIndex
+ * \brief The KDynamicWallpaperMetaDataIndex class provides a persistent cache of parsed
+ * wallpaper metadata.
+ *
+ * Every wallpaper file gets a small JSON sidecar in the kdynamicwallpaper/metadata directory
+ * under QStandardPaths::GenericCacheLocation. A sidecar holds the parsed metadata, the number
+ * of images and the image dimensions, as well as the modification time, the size and the
+ * inode of the file the entry has been created for. If any of them doesn't match the file on
+ * disk anymore, the entry is considered stale and it will be replaced the next time the file
+ * is parsed.
+ *
+ * Sidecars are written with QSaveFile, i.e. they are atomically replaced, so concurrent
+ * readers and writers, in the same or in different processes, never observe partially
+ * written entries.
+ *
+ * The index is pruned whenever an entry is stored. Entries that haven't been used for a while
+ * are removed, as are the least recently used entries above a fixed count, so sidecars of
+ * wallpapers that have been deleted or moved don't pile up.
+ */
+
+// Entries that haven't been used for this many days are removed.
+static const int s_maxEntryAge = 60;
+
+// The maximum number of entries in the index.
+static const int s_maxEntryCount = 512;
+
+static QString indexRoot()
+{
+    const QString cache = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+    return cache + QLatin1String("/kdynamicwallpaper/metadata/");
+}
+
+static QString indexFileName(const KDynamicWallpaperFileKey &key)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QFile::encodeName(key.filePath));
+    return indexRoot() + QString::fromLatin1(hash.result().toHex()) + QStringLiteral(".json");
+}
+
+/*!
+ * Returns the index entry for the file identified by \a key, or nullopt if the index has no
+ * entry for the file or the entry is stale.
+ */
+std::optional<KDynamicWallpaperMetaDataIndex::Entry> KDynamicWallpaperMetaDataIndex::load(const KDynamicWallpaperFileKey &key)
+{
+    if (!key.isValid())
+        return std::nullopt;
+
+    QFile file(indexFileName(key));
+    if (!file.open(QFile::ReadOnly))
+        return std::nullopt;
+
+    const QJsonObject object = QJsonDocument::fromJson(file.readAll()).object();
+    if (object[QLatin1String("path")].toString() != key.filePath
+        || object[QLatin1String("lastModified")].toInteger() != key.lastModified
+        || object[QLatin1String("size")].toInteger() != key.size
+        || quint64(object[QLatin1String("inode")].toInteger()) != key.inode) {
+        return std::nullopt;
+    }
+
+    Entry entry;
+    entry.imageCount = object[QLatin1String("imageCount")].toInt();
+    entry.imageSize = QSize(object[QLatin1String("width")].toInt(), object[QLatin1String("height")].toInt());
+
+    const QString type = object[QLatin1String("type")].toString();
+    const QJsonArray array = object[QLatin1String("metaData")].toArray();
+    for (int i = 0; i < array.size(); ++i) {
+        if (type == QLatin1String("solar")) {
+            const KSolarDynamicWallpaperMetaData metaData = KSolarDynamicWallpaperMetaData::fromJson(array[i].toObject());
+            if (metaData.isValid())
+                entry.metaData.append(metaData);
+        } else if (type == QLatin1String("day-night")) {
+            const KDayNightDynamicWallpaperMetaData metaData = KDayNightDynamicWallpaperMetaData::fromJson(array[i].toObject());
+            if (metaData.isValid())
+                entry.metaData.append(metaData);
+        }
+    }
+
+    if (entry.metaData.isEmpty())
+        return std::nullopt;
+
+    // The modification time of a sidecar tells when it was last used, touch it at most once a
+    // day so that loading an entry doesn't write to the disk every time.
+    const QDateTime now = QDateTime::currentDateTime();
+    if (file.fileTime(QFileDevice::FileModificationTime).daysTo(now) >= 1)
+        file.setFileTime(now, QFileDevice::FileModificationTime);
+
+    return entry;
+}
+
+/*!
+ * Removes the entries that have expired or that exceed the maximum entry count from the index
+ * stored in \a root.
+ */
+static void prune(const QDir &root)
+{
+    const QDateTime oldest = QDateTime::currentDateTime().addDays(-s_maxEntryAge);
+    const QFileInfoList entries = root.entryInfoList({QStringLiteral("*.json")}, QDir::Files, QDir::Time);
+    for (int i = 0; i < entries.size(); ++i) {
+        if (i >= s_maxEntryCount || entries[i].lastModified() < oldest)
+            QFile::remove(entries[i].filePath());
+    }
+}
+
+/*!
+ * Stores the \a entry for the file identified by \a key in the index.
+ */
+void KDynamicWallpaperMetaDataIndex::store(const KDynamicWallpaperFileKey &key, const Entry &entry)
+{
+    if (!key.isValid())
+        return;
+
+    QString type;
+    QJsonArray array;
+    for (const KDynamicWallpaperMetaData &md : entry.metaData) {
+        if (auto solar = std::get_if<KSolarDynamicWallpaperMetaData>(&md)) {
+            type = QStringLiteral("solar");
+            array.append(solar->toJson());
+        } else if (auto dayNight = std::get_if<KDayNightDynamicWallpaperMetaData>(&md)) {
+            type = QStringLiteral("day-night");
+            array.append(dayNight->toJson());
+        }
+    }
+
+    QJsonObject object;
+    object[QLatin1String("path")] = key.filePath;
+    object[QLatin1String("lastModified")] = key.lastModified;
+    object[QLatin1String("size")] = key.size;
+    object[QLatin1String("inode")] = qint64(key.inode);
+    object[QLatin1String("imageCount")] = entry.imageCount;
+    object[QLatin1String("width")] = entry.imageSize.width();
+    object[QLatin1String("height")] = entry.imageSize.height();
+    object[QLatin1String("type")] = type;
+    object[QLatin1String("metaData")] = array;
+
+    const QDir root(indexRoot());
+    if (!root.exists())
+        root.mkpath(QStringLiteral("."));
+
+    QSaveFile file(indexFileName(key));
+    if (!file.open(QFile::WriteOnly))
+        return;
+    file.write(QJsonDocument(object).toJson(QJsonDocument::Compact));
+    if (file.commit())
+        prune(root);
+}
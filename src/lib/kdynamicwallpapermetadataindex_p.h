@@ -0,0 +1,29 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "kdynamicwallpaperfilekey_p.h"
+#include "kdynamicwallpapermetadata.h"
+
+#include <QList>
+#include <QSize>
+
+#include <optional>
+
+class KDynamicWallpaperMetaDataIndex
+{
+public:
+    struct Entry
+    {
+        QList<KDynamicWallpaperMetaData> metaData;
+        QSize imageSize;
+        int imageCount = 0;
+    };
+
+    static std::optional<Entry> load(const KDynamicWallpaperFileKey &key);
+    static void store(const KDynamicWallpaperFileKey &key, const Entry &entry);
+};
@@ -5,18 +5,29 @@
  */
 
 #include "kdynamicwallpaperreader.h"
+#include "kdynamicwallpaperbufferpool_p.h"
+#include "kdynamicwallpapercontainer_p.h"
+#include "kdynamicwallpaperdebug_p.h"
+#include "kdynamicwallpaperdocument.h"
+#include "kdynamicwallpapermetadataindex_p.h"
+#include "kdynamicwallpaperthreadbudget_p.h"
+#include "kdynamicwallpaperxmp_p.h"
 
-#include <QDomDocument>
-#include <QDomNode>
+#include <QBuffer>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QImage>
-#include <QJsonArray>
-#include <QJsonDocument>
+#include <QPromise>
 #include <QScopeGuard>
+#include <QSemaphore>
 #include <QThread>
+#include <QThreadPool>
 
 #include <avif/avif.h>
 
+#include <algorithm>
+#include <memory>
+
 /*!
  * \class KDynamicWallpaperReader
  * \brief The KDynamicWallpaperReader class provides a convenient way for reading dynamic
@@ -34,138 +45,371 @@ public:
     KDynamicWallpaperReaderPrivate();
 
     bool open();
+    bool openMetaData();
     void close();
+    bool map();
+    void unmap();
+    bool readMetaData(const QByteArray &xmp);
+    QByteArray mappedData() const;
+    QByteArray readRange(const KDynamicWallpaperContainer::Range &range);
+    bool loadExtensions();
+    bool loadThumbnails();
 
-    QImage fetch(int imageIndex);
+    const avifImage *decode(int imageIndex);
+    const avifImage *decodeFrame(int imageIndex);
+    int currentImageIndex() const;
+    bool fetch(int imageIndex, const QRect &rect, const QSize &size, Qt::TransformationMode mode, QImage *image);
+    QImage fetchThumbnail(int imageIndex);
+    QImage convert(const avifImage *source, Qt::TransformationMode mode, QImage *target = nullptr);
+    void logStatistics(const char *operation) const;
 
     QIODevice *device;
+    KDynamicWallpaperDocument document;
     QByteArray buffer;
+    uchar *mapping;
+    qint64 mappingSize;
     avifDecoder *decoder;
+    avifDecoder *thumbnailDecoder;
+    QByteArray thumbnailData;
+    bool thumbnailsLoaded;
+    avifDecoder *frameDecoder;
+    QByteArray frameData;
+    int frameIndex;
+    KDynamicWallpaperContainer::Range xmpRange;
+    KDynamicWallpaperContainer::Range thumbnailRange;
+    QList<KDynamicWallpaperContainer::Range> frameRanges;
+    bool extensionsLoaded;
     KDynamicWallpaperReader::WallpaperReaderError wallpaperReaderError;
     QString errorString;
     QList<KDynamicWallpaperMetaData> metaData;
+    QList<int> nearestKeyframes;
+    QSize imageSize;
+    int imageCount;
+    int threadCount;
+    std::optional<int> maxThreadCount;
+    KDynamicWallpaperReader::Priority priority;
+    KDynamicWallpaperReader::OpenMode openMode;
     bool isDeviceForeign;
+    KDynamicWallpaperReader::Statistics statistics;
 };
 
 KDynamicWallpaperReaderPrivate::KDynamicWallpaperReaderPrivate()
     : device(nullptr)
+    , mapping(nullptr)
+    , mappingSize(0)
     , decoder(nullptr)
+    , thumbnailDecoder(nullptr)
+    , thumbnailsLoaded(false)
+    , frameDecoder(nullptr)
+    , frameIndex(-1)
+    , extensionsLoaded(false)
     , wallpaperReaderError(KDynamicWallpaperReader::NoError)
+    , imageCount(0)
+    , threadCount(0)
+    , priority(KDynamicWallpaperReader::NormalPriority)
+    , openMode(KDynamicWallpaperReader::ReadImages)
     , isDeviceForeign(false)
 {
 }
 
-static QList<KDynamicWallpaperMetaData> parseSolarMetaData(const QByteArray &xmp)
+/*!
+ * \internal
+ *
+ * The KDynamicWallpaperDeviceIO struct provides an avifIO implementation that reads the
+ * encoded data from a random-access QIODevice on demand, so only the boxes and samples that
+ * libavif actually needs are read from the device.
+ */
+struct KDynamicWallpaperDeviceIO
 {
-    QDomDocument xmpDocument;
-    xmpDocument.setContent(xmp);
-    if (xmpDocument.isNull())
-        return QList<KDynamicWallpaperMetaData>();
+    avifIO io;
+    QIODevice *device;
+    QByteArray buffer;
+    KDynamicWallpaperReader::Statistics *statistics;
+};
 
-    const QString attributeName = QStringLiteral("plasma:dynamic-wallpaper-solar");
-    const QDomNodeList descriptionNodes = xmpDocument.elementsByTagName(QStringLiteral("rdf:Description"));
-    for (int i = 0; i < descriptionNodes.count(); ++i) {
-        QDomElement descriptionNode = descriptionNodes.at(i).toElement();
-        const QByteArray base64 = descriptionNode.attribute(attributeName).toUtf8();
-        if (base64.isEmpty())
-            continue;
+static avifResult deviceRead(avifIO *io, uint32_t readFlags, uint64_t offset, size_t size, avifROData *out)
+{
+    if (readFlags != 0)
+        return AVIF_RESULT_IO_ERROR;
+    if (offset > io->sizeHint)
+        return AVIF_RESULT_IO_ERROR;
 
-        const QJsonArray array = QJsonDocument::fromJson(QByteArray::fromBase64(base64)).array();
-        QList<KDynamicWallpaperMetaData> result;
-        for (int i = 0; i < array.size(); ++i) {
-            KSolarDynamicWallpaperMetaData metaData = KSolarDynamicWallpaperMetaData::fromJson(array[i].toObject());
-            if (metaData.isValid())
-                result.append(metaData);
-        }
-        return result;
-    }
+    KDynamicWallpaperDeviceIO *deviceIO = static_cast<KDynamicWallpaperDeviceIO *>(io->data);
+    size = std::min<uint64_t>(size, io->sizeHint - offset);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!deviceIO->device->seek(offset))
+        return AVIF_RESULT_IO_ERROR;
+
+    deviceIO->buffer.resize(size);
+    const qint64 bytesRead = deviceIO->device->read(deviceIO->buffer.data(), size);
+    if (bytesRead < 0)
+        return AVIF_RESULT_IO_ERROR;
+
+    deviceIO->statistics->ioTime += timer.nsecsElapsed();
+    deviceIO->statistics->bytesRead += bytesRead;
+
+    out->data = reinterpret_cast<const uint8_t *>(deviceIO->buffer.constData());
+    out->size = bytesRead;
+    return AVIF_RESULT_OK;
+}
 
-    return QList<KDynamicWallpaperMetaData>();
+static void deviceDestroy(avifIO *io)
+{
+    delete static_cast<KDynamicWallpaperDeviceIO *>(io->data);
 }
 
-static QList<KDynamicWallpaperMetaData> parseDayNightMetaData(const QByteArray &xmp)
+static avifIO *createDeviceIO(QIODevice *device, KDynamicWallpaperReader::Statistics *statistics)
 {
-    QDomDocument xmpDocument;
-    xmpDocument.setContent(xmp);
-    if (xmpDocument.isNull())
-        return QList<KDynamicWallpaperMetaData>();
+    KDynamicWallpaperDeviceIO *deviceIO = new KDynamicWallpaperDeviceIO{};
+    deviceIO->io.destroy = deviceDestroy;
+    deviceIO->io.read = deviceRead;
+    deviceIO->io.sizeHint = device->size();
+    deviceIO->io.persistent = AVIF_FALSE;
+    deviceIO->io.data = deviceIO;
+    deviceIO->device = device;
+    deviceIO->statistics = statistics;
+    return &deviceIO->io;
+}
 
-    const QString attributeName = QStringLiteral("plasma:dynamic-wallpaper-day-night");
-    const QDomNodeList descriptionNodes = xmpDocument.elementsByTagName(QStringLiteral("rdf:Description"));
-    for (int i = 0; i < descriptionNodes.count(); ++i) {
-        QDomElement descriptionNode = descriptionNodes.at(i).toElement();
-        const QByteArray base64 = descriptionNode.attribute(attributeName).toUtf8();
-        if (base64.isEmpty())
-            continue;
+/*!
+ * \internal
+ *
+ * Maps the contents of the assigned file into memory so the decoder can read the file
+ * without copying it to the heap. Returns \c false if the device is not a QFile or if
+ * the file cannot be mapped.
+ */
+bool KDynamicWallpaperReaderPrivate::map()
+{
+    QFile *file = qobject_cast<QFile *>(device);
+    if (!file)
+        return false;
 
-        const QJsonArray array = QJsonDocument::fromJson(QByteArray::fromBase64(base64)).array();
-        QList<KDynamicWallpaperMetaData> result;
-        for (int i = 0; i < array.size(); ++i) {
-            KDayNightDynamicWallpaperMetaData metaData = KDayNightDynamicWallpaperMetaData::fromJson(array[i].toObject());
-            if (metaData.isValid())
-                result.append(metaData);
-        }
-        return result;
-    }
+    const qint64 size = file->size();
+    if (size <= 0)
+        return false;
 
-    return QList<KDynamicWallpaperMetaData>();
+    mapping = file->map(0, size);
+    if (!mapping)
+        return false;
+
+    mappingSize = size;
+    statistics.bytesMapped += size;
+    return true;
+}
+
+void KDynamicWallpaperReaderPrivate::unmap()
+{
+    if (!mapping)
+        return;
+
+    if (QFile *file = qobject_cast<QFile *>(device))
+        file->unmap(mapping);
+
+    mapping = nullptr;
+    mappingSize = 0;
 }
 
 bool KDynamicWallpaperReaderPrivate::open()
 {
-    if (!device) {
+    if (!document.isNull()) {
+        // The document has already been parsed, decode straight from its data.
+        if (!document.isValid()) {
+            wallpaperReaderError = KDynamicWallpaperReader::OpenError;
+            errorString = document.errorString();
+            return false;
+        }
+        buffer = document.data();
+        metaData = document.metaData();
+        imageCount = document.imageCount();
+        imageSize = document.imageSize();
+        if (openMode == KDynamicWallpaperReader::ReadMetaDataOnly)
+            return true;
+    } else if (device) {
+        if (device->isOpen()) {
+            if (!(device->openMode() & QIODevice::ReadOnly)) {
+                wallpaperReaderError = KDynamicWallpaperReader::OpenError;
+                errorString = QStringLiteral("The device is not open for reading");
+                return false;
+            }
+        } else {
+            if (!device->open(QIODevice::ReadOnly)) {
+                wallpaperReaderError = KDynamicWallpaperReader::OpenError;
+                errorString = device->errorString();
+                return false;
+            }
+        }
+    } else if (buffer.isNull()) {
         wallpaperReaderError = KDynamicWallpaperReader::OpenError;
         errorString = QStringLiteral("No assigned device");
         return false;
     }
 
-    if (device->isOpen()) {
-        if (!(device->openMode() & QIODevice::ReadOnly)) {
-            wallpaperReaderError = KDynamicWallpaperReader::OpenError;
-            errorString = QStringLiteral("The device is not open for reading");
-            return false;
-        }
-    } else {
-        if (!device->open(QIODevice::ReadOnly)) {
-            wallpaperReaderError = KDynamicWallpaperReader::OpenError;
-            errorString = device->errorString();
-            return false;
-        }
+    if (openMode == KDynamicWallpaperReader::ReadMetaDataOnly)
+        return openMetaData();
+
+    // Random-access devices are read on demand, see createDeviceIO().
+    QElapsedTimer timer;
+    timer.start();
+    if (device && !map() && device->isSequential()) {
+        buffer = device->readAll();
+        statistics.bytesRead += buffer.size();
     }
+    statistics.ioTime += timer.nsecsElapsed();
+
+    // libavif hands maxThreads to the codec when the codec is created, and the codec keeps its
+    // threads until the decoder is destroyed. So the threads are taken from the global budget
+    // here and given back in close(). The same threads are used to convert the decoded frames.
+    int desiredThreadCount = QThread::idealThreadCount();
+    if (maxThreadCount)
+        desiredThreadCount = std::max(1, *maxThreadCount);
+    else if (priority == KDynamicWallpaperReader::LowPriority)
+        desiredThreadCount = std::max(1, desiredThreadCount / 4);
+    threadCount = KDynamicWallpaperThreadBudget::self()->acquire(desiredThreadCount);
 
     decoder = avifDecoderCreate();
-    decoder->maxThreads = QThread::idealThreadCount();
+    decoder->maxThreads = threadCount;
 
     auto cleanup = qScopeGuard([this]() {
         avifDecoderDestroy(decoder);
         decoder = nullptr;
+        KDynamicWallpaperThreadBudget::self()->release(threadCount);
+        threadCount = 0;
     });
 
-    buffer = device->readAll();
-    avifResult result = avifDecoderSetIOMemory(decoder, reinterpret_cast<const uint8_t *>(buffer.constData()), buffer.size());
+    avifResult result = AVIF_RESULT_OK;
+    if (mapping)
+        result = avifDecoderSetIOMemory(decoder, mapping, mappingSize);
+    else if (!buffer.isNull())
+        result = avifDecoderSetIOMemory(decoder, reinterpret_cast<const uint8_t *>(buffer.constData()), buffer.size());
+    else
+        avifDecoderSetIO(decoder, createDeviceIO(device, &statistics));
     if (result != AVIF_RESULT_OK) {
         wallpaperReaderError = KDynamicWallpaperReader::OpenError;
         errorString = QString::fromUtf8(avifResultToString(result));
         return false;
     }
 
+    // The time spent reading the device on demand is accounted as I/O rather than parsing.
+    const qint64 ioTime = statistics.ioTime;
+    timer.restart();
     result = avifDecoderParse(decoder);
+    statistics.containerParseTime += timer.nsecsElapsed() - (statistics.ioTime - ioTime);
     if (result != AVIF_RESULT_OK) {
         wallpaperReaderError = KDynamicWallpaperReader::OpenError;
         errorString = QString::fromUtf8(avifResultToString(result));
         return false;
     }
 
-    if (!decoder->image->xmp.size) {
+    if (document.isNull()) {
+        // With the item layout, the metadata is stored in the extension box.
+        QByteArray rawMetaData;
+        if (decoder->image->xmp.size)
+            rawMetaData = QByteArray::fromRawData(reinterpret_cast<const char *>(decoder->image->xmp.data), decoder->image->xmp.size);
+        else if (loadExtensions() && !xmpRange.isNull())
+            rawMetaData = readRange(xmpRange);
+
+        if (rawMetaData.isEmpty()) {
+            wallpaperReaderError = KDynamicWallpaperReader::OpenError;
+            errorString = QStringLiteral("No metadata");
+            return false;
+        }
+
+        if (!readMetaData(rawMetaData))
+            return false;
+    }
+
+    imageSize = QSize(decoder->image->width, decoder->image->height);
+
+    // With the item layout, the primary image is the first wallpaper image and the following
+    // images are stored in the extension box, every image is a keyframe.
+    if (decoder->imageCount == 1 && loadExtensions() && !frameRanges.isEmpty()) {
+        imageCount = frameRanges.size() + 1;
+        for (int i = 0; i < imageCount; ++i)
+            nearestKeyframes.append(i);
+    } else {
+        frameRanges.clear();
+        imageCount = decoder->imageCount;
+
+        // The sync sample table is already known after parsing, no frames are decoded here.
+        nearestKeyframes.reserve(imageCount);
+        for (int i = 0; i < imageCount; ++i)
+            nearestKeyframes.append(avifDecoderNearestKeyframe(decoder, i));
+    }
+
+    logStatistics("Opened");
+
+    cleanup.dismiss();
+    return true;
+}
+
+/*!
+ * \internal
+ *
+ * Reads the metadata, the number of images and the image dimensions without creating an
+ * avifDecoder. Only the container boxes and the XMP packet are read, and for files that are
+ * already in the metadata index, not even that.
+ */
+bool KDynamicWallpaperReaderPrivate::openMetaData()
+{
+    // Files that have been seen before don't need to be parsed again.
+    const QFile *file = qobject_cast<QFile *>(device);
+    const KDynamicWallpaperFileKey fileKey = file ? KDynamicWallpaperFileKey::fromFileName(file->fileName()) : KDynamicWallpaperFileKey();
+    QElapsedTimer timer;
+    timer.start();
+    if (const auto entry = KDynamicWallpaperMetaDataIndex::load(fileKey)) {
+        metaData = entry->metaData;
+        imageCount = entry->imageCount;
+        imageSize = entry->imageSize;
+        statistics.metaDataParseTime += timer.nsecsElapsed();
+        logStatistics("Opened indexed");
+        return true;
+    }
+
+    if (device && device->isSequential()) {
+        timer.restart();
+        buffer = device->readAll();
+        statistics.ioTime += timer.nsecsElapsed();
+        statistics.bytesRead += buffer.size();
+    }
+
+    QBuffer dataDevice(&buffer);
+    QIODevice *input = device;
+    if (!buffer.isNull()) {
+        dataDevice.open(QIODevice::ReadOnly);
+        input = &dataDevice;
+    }
+
+    // The container boxes are read with a handful of small reads, they are accounted as parsing.
+    KDynamicWallpaperContainer container;
+    timer.restart();
+    const bool ok = container.read(input);
+    statistics.containerParseTime += timer.nsecsElapsed();
+    if (!ok) {
         wallpaperReaderError = KDynamicWallpaperReader::OpenError;
-        errorString = QStringLiteral("No metadata");
+        errorString = container.errorString();
         return false;
     }
 
-    const QByteArray rawMetaData = QByteArray::fromRawData(reinterpret_cast<const char *>(decoder->image->xmp.data), decoder->image->xmp.size);
-    metaData = parseSolarMetaData(rawMetaData);
-    if (metaData.isEmpty())
-        metaData = parseDayNightMetaData(rawMetaData);
+    if (!readMetaData(container.xmp()))
+        return false;
+
+    imageCount = container.imageCount();
+    imageSize = container.imageSize();
+    logStatistics("Opened");
+
+    KDynamicWallpaperMetaDataIndex::store(fileKey, KDynamicWallpaperMetaDataIndex::Entry{metaData, imageSize, imageCount});
+    return true;
+}
+
+bool KDynamicWallpaperReaderPrivate::readMetaData(const QByteArray &xmp)
+{
+    QElapsedTimer timer;
+    timer.start();
+    metaData = KDynamicWallpaperXmp::parse(xmp);
+    statistics.metaDataParseTime += timer.nsecsElapsed();
 
     if (metaData.isEmpty()) {
         wallpaperReaderError = KDynamicWallpaperReader::OpenError;
@@ -173,7 +417,115 @@ bool KDynamicWallpaperReaderPrivate::open()
         return false;
     }
 
-    cleanup.dismiss();
+    return true;
+}
+
+/*!
+ * \internal
+ *
+ * Returns the contents of the file without copying them if the whole file is in memory;
+ * otherwise returns a null QByteArray.
+ */
+QByteArray KDynamicWallpaperReaderPrivate::mappedData() const
+{
+    if (mapping)
+        return QByteArray::fromRawData(reinterpret_cast<const char *>(mapping), mappingSize);
+    if (!buffer.isNull())
+        return QByteArray::fromRawData(buffer.constData(), buffer.size());
+    return QByteArray();
+}
+
+/*!
+ * \internal
+ *
+ * Returns the data in the specified \a range of the file, or a null QByteArray if the data
+ * cannot be read. The data is referenced in place if the whole file is already in memory.
+ */
+QByteArray KDynamicWallpaperReaderPrivate::readRange(const KDynamicWallpaperContainer::Range &range)
+{
+    if (const QByteArray data = mappedData(); !data.isNull())
+        return QByteArray::fromRawData(data.constData() + range.offset, range.length);
+
+    QElapsedTimer timer;
+    timer.start();
+    if (!device->seek(range.offset))
+        return QByteArray();
+    const QByteArray data = device->read(range.length);
+    statistics.ioTime += timer.nsecsElapsed();
+    statistics.bytesRead += data.size();
+    if (data.size() != range.length)
+        return QByteArray();
+    return data;
+}
+
+/*!
+ * \internal
+ *
+ * Looks up the locations of the thumbnails and the independently encoded images in the
+ * extension box. Returns \c false if the extension box cannot be read.
+ *
+ * Only the top-level box headers are read, so this is cheap even if the reader has been opened
+ * in the metadata-only mode.
+ */
+bool KDynamicWallpaperReaderPrivate::loadExtensions()
+{
+    if (extensionsLoaded)
+        return true;
+
+    QByteArray data = mappedData();
+    QBuffer dataDevice(&data);
+    QIODevice *input = device;
+    if (!data.isNull()) {
+        dataDevice.open(QIODevice::ReadOnly);
+        input = &dataDevice;
+    }
+    if (!input || input->isSequential())
+        return false;
+
+    KDynamicWallpaperContainer container;
+    if (!container.readExtensions(input))
+        return false;
+
+    xmpRange = container.xmpRange();
+    thumbnailRange = container.thumbnails();
+    frameRanges = container.frames();
+    extensionsLoaded = true;
+    return true;
+}
+
+/*!
+ * \internal
+ *
+ * Looks up the thumbnails embedded in the wallpaper and prepares a decoder for them. Returns
+ * \c true if the wallpaper has thumbnails; otherwise returns \c false.
+ */
+bool KDynamicWallpaperReaderPrivate::loadThumbnails()
+{
+    if (thumbnailsLoaded)
+        return thumbnailDecoder;
+    thumbnailsLoaded = true;
+
+    if (!loadExtensions() || thumbnailRange.isNull())
+        return false;
+
+    thumbnailData = readRange(thumbnailRange);
+    if (thumbnailData.isNull())
+        return false;
+
+    // Thumbnails are small, additional threads would only add overhead.
+    thumbnailDecoder = avifDecoderCreate();
+    thumbnailDecoder->maxThreads = 1;
+
+    avifResult result = avifDecoderSetIOMemory(thumbnailDecoder, reinterpret_cast<const uint8_t *>(thumbnailData.constData()), thumbnailData.size());
+    if (result == AVIF_RESULT_OK)
+        result = avifDecoderParse(thumbnailDecoder);
+    if (result != AVIF_RESULT_OK || (imageCount && thumbnailDecoder->imageCount != imageCount)) {
+        avifDecoderDestroy(thumbnailDecoder);
+        thumbnailDecoder = nullptr;
+        thumbnailData.clear();
+        return false;
+    }
+
     return true;
 }
 
@@ -181,24 +533,419 @@ void KDynamicWallpaperReaderPrivate::close()
 {
     if (decoder)
         avifDecoderDestroy(decoder);
-    if (!isDeviceForeign)
+    if (thumbnailDecoder)
+        avifDecoderDestroy(thumbnailDecoder);
+    if (frameDecoder)
+        avifDecoderDestroy(frameDecoder);
+    if (threadCount)
+        KDynamicWallpaperThreadBudget::self()->release(threadCount);
+    unmap();
+    if (device && !isDeviceForeign)
         device->deleteLater();
 
     decoder = nullptr;
+    thumbnailDecoder = nullptr;
+    thumbnailData.clear();
+    thumbnailsLoaded = false;
+    frameDecoder = nullptr;
+    frameData.clear();
+    frameIndex = -1;
+    xmpRange = KDynamicWallpaperContainer::Range();
+    thumbnailRange = KDynamicWallpaperContainer::Range();
+    frameRanges.clear();
+    extensionsLoaded = false;
+    threadCount = 0;
     device = nullptr;
     isDeviceForeign = false;
     buffer.clear();
+    document = KDynamicWallpaperDocument();
+    metaData.clear();
+    nearestKeyframes.clear();
+    imageSize = QSize();
+    imageCount = 0;
+    wallpaperReaderError = KDynamicWallpaperReader::NoError;
+    errorString.clear();
+    statistics = KDynamicWallpaperReader::Statistics();
+
+    // Don't keep the frame buffers of this wallpaper around if nothing uses them anymore.
+    KDynamicWallpaperBufferPool::self()->trim();
+}
+
+/*!
+ * \internal
+ *
+ * Returns the smallest rectangle that contains \a rect and whose top left corner is aligned to
+ * the chroma samples of the specified \a image.
+ */
+static QRect alignToChroma(const avifImage *image, const QRect &rect)
+{
+    QRect aligned = rect;
+    if (image->yuvFormat == AVIF_PIXEL_FORMAT_YUV420 || image->yuvFormat == AVIF_PIXEL_FORMAT_YUV422)
+        aligned.setLeft(rect.left() & ~1);
+    if (image->yuvFormat == AVIF_PIXEL_FORMAT_YUV420)
+        aligned.setTop(rect.top() & ~1);
+    return aligned;
+}
+
+/*!
+ * \internal
+ *
+ * Returns a view of the area \a rect in the specified \a image downscaled to \a size in the YUV
+ * domain, or \c nullptr if the view cannot be created by libavif, e.g. because libavif has been
+ * built without libyuv. The returned image must be destroyed with avifImageDestroy().
+ *
+ * The top left corner of \a rect must be aligned to the chroma samples.
+ */
+static avifImage *createView(const avifImage *image, const QRect &rect, const QSize &size)
+{
+#if AVIF_VERSION >= 1000000
+    // The view shares the planes with the decoder, avifImageScale() replaces them with the
+    // scaled planes without touching the decoder's buffers.
+    avifImage *view = avifImageCreateEmpty();
+    const avifCropRect cropRect{uint32_t(rect.x()), uint32_t(rect.y()), uint32_t(rect.width()), uint32_t(rect.height())};
+    if (avifImageSetViewRect(view, image, &cropRect) != AVIF_RESULT_OK) {
+        avifImageDestroy(view);
+        return nullptr;
+    }
+
+    if (size == rect.size())
+        return view;
+
+    avifDiagnostics diagnostics{};
+    if (avifImageScale(view, size.width(), size.height(), &diagnostics) != AVIF_RESULT_OK) {
+        avifImageDestroy(view);
+        return nullptr;
+    }
+
+    return view;
+#else
+    Q_UNUSED(image)
+    Q_UNUSED(rect)
+    Q_UNUSED(size)
+    return nullptr;
+#endif
 }
 
-QImage KDynamicWallpaperReaderPrivate::fetch(int index)
+/*!
+ * \internal
+ *
+ * Returns the index of the image that has been decoded most recently, or -1 if no image has
+ * been decoded yet.
+ */
+int KDynamicWallpaperReaderPrivate::currentImageIndex() const
 {
-    avifResult result = avifDecoderNthImage(decoder, index);
+    if (frameIndex != -1)
+        return frameIndex;
+    return decoder ? decoder->imageIndex : -1;
+}
+
+/*!
+ * \internal
+ *
+ * Decodes the image with the specified index \a index and returns it, or \c nullptr if the
+ * image cannot be decoded. The returned image is owned by the decoder.
+ */
+const avifImage *KDynamicWallpaperReaderPrivate::decode(int index)
+{
+    // With the item layout, every image but the first one is a standalone AVIF file.
+    if (!frameRanges.isEmpty() && index > 0)
+        return decodeFrame(index);
+
+    if (frameDecoder) {
+        avifDecoderDestroy(frameDecoder);
+        frameDecoder = nullptr;
+        frameData.clear();
+        frameIndex = -1;
+    }
+
+    // The most recently decoded frame is still held by the decoder. If the requested frame is
+    // the next one, avifDecoderNthImage() decodes only that frame.
+    if (index != decoder->imageIndex) {
+        QElapsedTimer timer;
+        timer.start();
+
+        const int keyframe = nearestKeyframes.value(index, index);
+        const int currentIndex = decoder->imageIndex;
+        statistics.decodedFrameCount += (currentIndex >= keyframe && currentIndex < index) ? index - currentIndex : index - keyframe + 1;
+
+        const qint64 ioTime = statistics.ioTime;
+        const avifResult result = avifDecoderNthImage(decoder, index);
+        statistics.decodeTime += timer.nsecsElapsed() - (statistics.ioTime - ioTime);
+        if (result != AVIF_RESULT_OK) {
+            wallpaperReaderError = KDynamicWallpaperReader::ReadError;
+            errorString = QString::fromUtf8(avifResultToString(result));
+            return nullptr;
+        }
+    }
+
+    return decoder->image;
+}
+
+/*!
+ * \internal
+ *
+ * Decodes the independently encoded image with the specified index \a index. Only the data of
+ * that image is read, the other images are not touched.
+ */
+const avifImage *KDynamicWallpaperReaderPrivate::decodeFrame(int index)
+{
+    if (index == frameIndex)
+        return frameDecoder->image;
+
+    if (index >= imageCount) {
+        wallpaperReaderError = KDynamicWallpaperReader::ReadError;
+        errorString = QString::fromUtf8(avifResultToString(AVIF_RESULT_NO_IMAGES_REMAINING));
+        return nullptr;
+    }
+
+    if (frameDecoder) {
+        avifDecoderDestroy(frameDecoder);
+        frameDecoder = nullptr;
+        frameIndex = -1;
+    }
+
+    frameData = readRange(frameRanges[index - 1]);
+    if (frameData.isNull()) {
+        wallpaperReaderError = KDynamicWallpaperReader::ReadError;
+        errorString = QStringLiteral("Failed to read image %1").arg(index);
+        return nullptr;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // The frame decoder shares the threads of the reader, it never decodes at the same time
+    // as the main decoder.
+    frameDecoder = avifDecoderCreate();
+    frameDecoder->maxThreads = threadCount;
+
+    avifResult result = avifDecoderSetIOMemory(frameDecoder, reinterpret_cast<const uint8_t *>(frameData.constData()), frameData.size());
+    if (result == AVIF_RESULT_OK)
+        result = avifDecoderParse(frameDecoder);
+    if (result == AVIF_RESULT_OK)
+        result = avifDecoderNextImage(frameDecoder);
+    statistics.decodeTime += timer.nsecsElapsed();
     if (result != AVIF_RESULT_OK) {
+        avifDecoderDestroy(frameDecoder);
+        frameDecoder = nullptr;
+        frameData.clear();
         wallpaperReaderError = KDynamicWallpaperReader::ReadError;
         errorString = QString::fromUtf8(avifResultToString(result));
+        return nullptr;
+    }
+
+    ++statistics.decodedFrameCount;
+    frameIndex = index;
+    return frameDecoder->image;
+}
+
+bool KDynamicWallpaperReaderPrivate::fetch(int index, const QRect &rect, const QSize &size, Qt::TransformationMode mode, QImage *image)
+{
+    const avifImage *decoded = decode(index);
+    if (!decoded)
+        return false;
+
+    QElapsedTimer timer;
+    timer.start();
+    auto conversionTimer = qScopeGuard([this, &timer]() {
+        statistics.conversionTime += timer.nsecsElapsed();
+        logStatistics("Read image");
+    });
+
+    const QRect imageRect(0, 0, decoded->width, decoded->height);
+    const QRect sourceRect = rect.isNull() ? imageRect : rect.intersected(imageRect);
+    if (sourceRect.isEmpty()) {
+        wallpaperReaderError = KDynamicWallpaperReader::ReadError;
+        errorString = QStringLiteral("The source rectangle is outside of the image");
+        return false;
+    }
+
+    const QSize targetSize = size.isEmpty() ? sourceRect.size() : size;
+    const qreal scaleX = qreal(targetSize.width()) / sourceRect.width();
+    const qreal scaleY = qreal(targetSize.height()) / sourceRect.height();
+
+    // Only the pixels in the source rectangle are scaled and converted to RGB. The view may
+    // include an extra row or column of pixels in order to start at a chroma sample.
+    const QRect viewRect = alignToChroma(decoded, sourceRect);
+    QSize viewSize(qRound(viewRect.width() * scaleX), qRound(viewRect.height() * scaleY));
+
+    // Upscaling is left to QImage, there is nothing to win by doing it before the conversion.
+    if (viewSize.isEmpty() || viewSize.width() > viewRect.width() || viewSize.height() > viewRect.height())
+        viewSize = viewRect.size();
+
+    avifImage *view = nullptr;
+    if (viewRect != imageRect || viewSize != imageRect.size())
+        view = createView(decoded, viewRect, viewSize);
+    auto viewCleanup = qScopeGuard([&view]() {
+        if (view)
+            avifImageDestroy(view);
+    });
+
+    const avifImage *source = view ? view : decoded;
+    const QRect convertedRect(0, 0, source->width, source->height);
+
+    // Cut the source rectangle out of the converted pixels.
+    QRect clipRect = sourceRect;
+    if (view) {
+        const qreal viewScaleX = qreal(view->width) / viewRect.width();
+        const qreal viewScaleY = qreal(view->height) / viewRect.height();
+        clipRect = QRect(qRound((sourceRect.x() - viewRect.x()) * viewScaleX),
+                         qRound((sourceRect.y() - viewRect.y()) * viewScaleY),
+                         qRound(sourceRect.width() * viewScaleX),
+                         qRound(sourceRect.height() * viewScaleY));
+    }
+    clipRect &= convertedRect;
+
+    // If the converted pixels need no further processing, they can go straight to the image
+    // provided by the caller.
+    const bool isFinal = clipRect == convertedRect && convertedRect.size() == targetSize;
+    QImage converted = convert(source, mode, isFinal ? image : nullptr);
+    if (converted.isNull())
+        return false;
+
+    if (clipRect != convertedRect)
+        converted = converted.copy(clipRect);
+    if (converted.size() != targetSize)
+        converted = converted.scaled(targetSize, Qt::IgnoreAspectRatio, mode);
+
+    *image = converted;
+    return true;
+}
+
+QImage KDynamicWallpaperReaderPrivate::fetchThumbnail(int index)
+{
+    if (index < 0 || index >= int(thumbnailDecoder->imageCount)) {
+        wallpaperReaderError = KDynamicWallpaperReader::ReadError;
+        errorString = QStringLiteral("Invalid thumbnail index %1").arg(index);
         return QImage();
     }
 
+    if (index != thumbnailDecoder->imageIndex) {
+        const avifResult result = avifDecoderNthImage(thumbnailDecoder, index);
+        if (result != AVIF_RESULT_OK) {
+            wallpaperReaderError = KDynamicWallpaperReader::ReadError;
+            errorString = QString::fromUtf8(avifResultToString(result));
+            return QImage();
+        }
+    }
+
+    return convert(thumbnailDecoder->image, Qt::SmoothTransformation);
+}
+
+void KDynamicWallpaperReaderPrivate::logStatistics(const char *operation) const
+{
+    const QFile *file = qobject_cast<QFile *>(device);
+    const QString fileName = file ? file->fileName() : document.fileName();
+    qCDebug(KDYNAMICWALLPAPER, "%s %s: io %.2fms, container %.2fms, xmp %.2fms, decode %.2fms (%d frames), "
+                               "conversion %.2fms, read %lld bytes, mapped %lld bytes",
+            operation, qPrintable(fileName),
+            statistics.ioTime / 1e6, statistics.containerParseTime / 1e6, statistics.metaDataParseTime / 1e6,
+            statistics.decodeTime / 1e6, statistics.decodedFrameCount, statistics.conversionTime / 1e6,
+            statistics.bytesRead, statistics.bytesMapped);
+}
+
+Q_GLOBAL_STATIC(QThreadPool, s_conversionThreadPool)
+
+// Bands shorter than this are not worth the synchronization overhead.
+static const int s_minBandHeight = 128;
+
+/*!
+ * \internal
+ *
+ * Converts the specified \a source image to RGB and stores the result in \a pixels.
+ */
+static avifResult convertBandToRgb(const avifImage *source, avifRGBFormat format, avifChromaUpsampling upsampling, uint8_t *pixels, qsizetype bytesPerLine)
+{
+    avifRGBImage rgb;
+    avifRGBImageSetDefaults(&rgb, source);
+    rgb.format = format;
+    rgb.depth = 8;
+    rgb.chromaUpsampling = upsampling;
+    rgb.rowBytes = bytesPerLine;
+    rgb.pixels = pixels;
+    return avifImageYUVToRGB(source, &rgb);
+}
+
+/*!
+ * \internal
+ *
+ * Converts the specified \a source image to RGB using up to \a threadCount threads. The image
+ * is split into bands of rows, which are converted in parallel. The SIMD kernels that convert
+ * the bands are selected by libyuv at runtime.
+ *
+ * A band can only be converted independently if its pixels don't depend on the chroma samples
+ * of neighbor bands. That's not the case for 4:2:0 images with bilinear chroma upsampling, such
+ * images are converted on the calling thread.
+ */
+static avifResult convertToRgb(const avifImage *source, avifRGBFormat format, avifChromaUpsampling upsampling, uint8_t *pixels, qsizetype bytesPerLine, int threadCount)
+{
+    const int height = source->height;
+    const bool isSubsampledVertically = source->yuvFormat == AVIF_PIXEL_FORMAT_YUV420;
+
+    int bandCount = std::min(threadCount, height / s_minBandHeight);
+    if (isSubsampledVertically && upsampling != AVIF_CHROMA_UPSAMPLING_FASTEST)
+        bandCount = 1;
+
+#if AVIF_VERSION >= 1000000
+    if (bandCount > 1) {
+        // Vertically subsampled bands must start at a chroma row.
+        int bandHeight = (height + bandCount - 1) / bandCount;
+        if (isSubsampledVertically)
+            bandHeight += bandHeight % 2;
+
+        QList<avifImage *> bands;
+        for (int y = 0; y < height; y += bandHeight) {
+            avifImage *band = avifImageCreateEmpty();
+            const avifCropRect rect{0, uint32_t(y), source->width, uint32_t(std::min(bandHeight, height - y))};
+            if (avifImageSetViewRect(band, source, &rect) != AVIF_RESULT_OK) {
+                avifImageDestroy(band);
+                break;
+            }
+            bands.append(band);
+        }
+        auto bandsCleanup = qScopeGuard([&bands]() {
+            for (avifImage *band : std::as_const(bands))
+                avifImageDestroy(band);
+        });
+
+        if (bands.size() * bandHeight >= height) {
+            QList<avifResult> results(bands.size(), AVIF_RESULT_OK);
+            QSemaphore finished;
+
+            auto convertBand = [&](int i) {
+                uint8_t *bandPixels = pixels + qsizetype(i) * bandHeight * bytesPerLine;
+                results[i] = convertBandToRgb(bands[i], format, upsampling, bandPixels, bytesPerLine);
+            };
+
+            for (int i = 1; i < bands.size(); ++i) {
+                s_conversionThreadPool->start([&convertBand, &finished, i]() {
+                    convertBand(i);
+                    finished.release();
+                });
+            }
+            convertBand(0);
+            finished.acquire(bands.size() - 1);
+
+            for (const avifResult result : std::as_const(results)) {
+                if (result != AVIF_RESULT_OK)
+                    return result;
+            }
+            return AVIF_RESULT_OK;
+        }
+    }
+#endif
+
+    return convertBandToRgb(source, format, upsampling, pixels, bytesPerLine);
+}
+
+/*!
+ * \internal
+ *
+ * Converts the specified \a source image to RGB. If the \a target image has the right size and
+ * format, the pixels are written into it; otherwise the pixels are stored in a pooled buffer.
+ */
+QImage KDynamicWallpaperReaderPrivate::convert(const avifImage *source, Qt::TransformationMode mode, QImage *target)
+{
     const QImage::Format qtFormat = QImage::Format_RGB32;
 #if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
     const avifRGBFormat avifFormat = AVIF_RGB_FORMAT_BGRA;
@@ -206,15 +953,23 @@ QImage KDynamicWallpaperReaderPrivate::fetch(int index)
     const avifRGBFormat avifFormat = AVIF_RGB_FORMAT_ARGB;
 #endif
 
-    QImage image(decoder->image->width, decoder->image->height, qtFormat);
+    const QSize size(source->width, source->height);
 
-    avifRGBImage rgb;
-    avifRGBImageSetDefaults(&rgb, decoder->image);
-    rgb.format = avifFormat;
-    rgb.rowBytes = image.bytesPerLine();
-    rgb.pixels = image.bits();
+    // The target image is taken rather than copied, so writing into it doesn't detach it.
+    QImage image;
+    if (target && target->size() == size && target->format() == qtFormat)
+        image.swap(*target);
+    else
+        image = KDynamicWallpaperBufferPool::self()->createImage(size, qtFormat);
+    if (image.isNull()) {
+        wallpaperReaderError = KDynamicWallpaperReader::ReadError;
+        errorString = QStringLiteral("Failed to allocate an image");
+        return QImage();
+    }
+
+    const avifChromaUpsampling upsampling = mode == Qt::FastTransformation ? AVIF_CHROMA_UPSAMPLING_FASTEST : AVIF_CHROMA_UPSAMPLING_AUTOMATIC;
 
-    result = avifImageYUVToRGB(decoder->image, &rgb);
+    const avifResult result = convertToRgb(source, avifFormat, upsampling, image.bits(), image.bytesPerLine(), std::max(1, threadCount));
     if (result != AVIF_RESULT_OK) {
         wallpaperReaderError = KDynamicWallpaperReader::ReadError;
         errorString = QString::fromUtf8(avifResultToString(result));
@@ -234,6 +989,16 @@ KDynamicWallpaperReader::KDynamicWallpaperReader()
 {
 }
 
+/*!
+ * Constructs the KDynamicWallpaperReader with the parsed \p document and the open mode \p mode.
+ */
+KDynamicWallpaperReader::KDynamicWallpaperReader(const KDynamicWallpaperDocument &document, OpenMode mode)
+    : d(new KDynamicWallpaperReaderPrivate)
+{
+    d->openMode = mode;
+    setDocument(document);
+}
+
 /*!
  * Constructs the KDynamicWallpaperReader with the device \p device.
  */
@@ -243,6 +1008,16 @@ KDynamicWallpaperReader::KDynamicWallpaperReader(QIODevice *device)
     setDevice(device);
 }
 
+/*!
+ * Constructs the KDynamicWallpaperReader with the device \p device and the open mode \p mode.
+ */
+KDynamicWallpaperReader::KDynamicWallpaperReader(QIODevice *device, OpenMode mode)
+    : d(new KDynamicWallpaperReaderPrivate)
+{
+    d->openMode = mode;
+    setDevice(device);
+}
+
 /*!
  * Constructs the KDynamicWallpaperReader with the file name \p fileName.
  */
@@ -252,13 +1027,190 @@ KDynamicWallpaperReader::KDynamicWallpaperReader(const QString &fileName)
     setFileName(fileName);
 }
 
+/*!
+ * Constructs the KDynamicWallpaperReader with the file name \p fileName and the open mode
+ * \p mode.
+ */
+KDynamicWallpaperReader::KDynamicWallpaperReader(const QString &fileName, OpenMode mode)
+    : d(new KDynamicWallpaperReaderPrivate)
+{
+    d->openMode = mode;
+    setFileName(fileName);
+}
+
 /*!
  * Destructs the KDynamicWallpaperReader object.
  */
 KDynamicWallpaperReader::~KDynamicWallpaperReader()
 {
-    if (d->device)
-        d->close();
+    d->close();
+}
+
+/*!
+ * Sets the open mode of the reader to \p mode. The open mode takes effect the next time a
+ * device, a file name or data is assigned to the reader.
+ *
+ * In the ReadMetaDataOnly mode, the reader only walks the container boxes to find the metadata,
+ * the number of images and the image dimensions. No AV1 decoder is created, so image() will
+ * return a null QImage. The default open mode is ReadImages.
+ */
+void KDynamicWallpaperReader::setOpenMode(OpenMode mode)
+{
+    d->openMode = mode;
+}
+
+/*!
+ * Returns the open mode of the reader.
+ */
+KDynamicWallpaperReader::OpenMode KDynamicWallpaperReader::openMode() const
+{
+    return d->openMode;
+}
+
+/*!
+ * Sets the priority of the reader to \p priority. The priority takes effect the next time a
+ * device, a file name or data is assigned to the reader.
+ *
+ * Decoder threads are shared by all readers in the process. Readers with the LowPriority
+ * priority ask for fewer threads, which is useful for background work such as generating
+ * previews. The default priority is NormalPriority.
+ */
+void KDynamicWallpaperReader::setPriority(Priority priority)
+{
+    d->priority = priority;
+}
+
+/*!
+ * Returns the priority of the reader.
+ */
+KDynamicWallpaperReader::Priority KDynamicWallpaperReader::priority() const
+{
+    return d->priority;
+}
+
+/*!
+ * Sets the desired maximum number of threads that can be used to decode images to \p max,
+ * overriding the number of threads derived from the priority. The limit takes effect the
+ * next time a device, a file name or data is assigned to the reader.
+ *
+ * Note that the reader may get fewer threads if other readers are busy decoding images, see
+ * setGlobalMaxThreadCount().
+ */
+void KDynamicWallpaperReader::setMaxThreadCount(int max)
+{
+    d->maxThreadCount = max;
+}
+
+/*!
+ * Returns the maximum number of threads that can be used to decode images. If nullopt is
+ * returned, the number of threads is derived from the priority of the reader.
+ */
+std::optional<int> KDynamicWallpaperReader::maxThreadCount() const
+{
+    return d->maxThreadCount;
+}
+
+Q_GLOBAL_STATIC(QThreadPool, s_asyncThreadPool)
+
+/*!
+ * \internal
+ *
+ * Runs the specified \a function on the library thread pool. Low priority tasks start only
+ * after all pending normal priority tasks have been started.
+ */
+template<typename T, typename Function>
+static QFuture<T> runAsync(KDynamicWallpaperReader::Priority priority, Function function)
+{
+    auto promise = std::make_shared<QPromise<T>>();
+    QFuture<T> future = promise->future();
+    promise->start();
+
+    const int threadPriority = priority == KDynamicWallpaperReader::LowPriority ? 0 : 1;
+    s_asyncThreadPool->start([promise, function]() {
+        if (!promise->isCanceled())
+            function(*promise);
+        promise->finish();
+    }, threadPriority);
+
+    return future;
+}
+
+/*!
+ * Decodes the image with the specified index \p imageIndex scaled to \p size from the file
+ * \p fileName on a thread pool owned by the library. If the image cannot be decoded, the
+ * returned future finishes without a result and the error is logged.
+ *
+ * The task can be canceled with QFuture::cancel() as long as it hasn't started decoding. All
+ * tasks for the same file share a single KDynamicWallpaperDocument, so the file is read and
+ * parsed only once.
+ */
+QFuture<QImage> KDynamicWallpaperReader::imageAsync(const QString &fileName, int imageIndex, const QSize &size, Priority priority)
+{
+    return runAsync<QImage>(priority, [fileName, imageIndex, size, priority](QPromise<QImage> &promise) {
+        const KDynamicWallpaperDocument document = KDynamicWallpaperDocument::load(fileName);
+        if (!document.isValid()) {
+            qCWarning(KDYNAMICWALLPAPER, "Failed to load %s: %s", qPrintable(fileName), qPrintable(document.errorString()));
+            return;
+        }
+        if (promise.isCanceled())
+            return;
+
+        KDynamicWallpaperReader reader;
+        reader.setPriority(priority);
+        reader.setDocument(document);
+
+        const QImage image = reader.image(imageIndex, size);
+        if (image.isNull()) {
+            qCWarning(KDYNAMICWALLPAPER, "Failed to read image %d from %s: %s", imageIndex, qPrintable(fileName), qPrintable(reader.errorString()));
+            return;
+        }
+
+        promise.addResult(image);
+    });
+}
+
+/*!
+ * Reads the metadata of the file \p fileName on a thread pool owned by the library. If the
+ * file is not a dynamic wallpaper, the returned future finishes without a result.
+ *
+ * No decoder is created, see ReadMetaDataOnly.
+ */
+QFuture<QList<KDynamicWallpaperMetaData>> KDynamicWallpaperReader::metaDataAsync(const QString &fileName, Priority priority)
+{
+    return runAsync<QList<KDynamicWallpaperMetaData>>(priority, [fileName](QPromise<QList<KDynamicWallpaperMetaData>> &promise) {
+        const KDynamicWallpaperReader reader(fileName, ReadMetaDataOnly);
+        if (reader.error() != NoError) {
+            qCDebug(KDYNAMICWALLPAPER, "Failed to read metadata from %s: %s", qPrintable(fileName), qPrintable(reader.errorString()));
+            return;
+        }
+
+        promise.addResult(reader.metaData());
+    });
+}
+
+/*!
+ * Sets the total number of decoder threads shared by all readers in the process to \p max.
+ * The default is QThread::idealThreadCount().
+ *
+ * The limit also applies to the threads that convert decoded images and to the threads that
+ * run asynchronous reads. Readers that are already open keep their threads until they are
+ * closed.
+ */
+void KDynamicWallpaperReader::setGlobalMaxThreadCount(int max)
+{
+    KDynamicWallpaperThreadBudget::self()->setCapacity(max);
+
+    const int capacity = KDynamicWallpaperThreadBudget::self()->capacity();
+    s_conversionThreadPool->setMaxThreadCount(capacity);
+    s_asyncThreadPool->setMaxThreadCount(capacity);
+}
+
+/*!
+ * Returns the total number of decoder threads shared by all readers in the process.
+ */
+int KDynamicWallpaperReader::globalMaxThreadCount()
+{
+    return KDynamicWallpaperThreadBudget::self()->capacity();
 }
 
 /*!
@@ -266,11 +1218,12 @@ KDynamicWallpaperReader::~KDynamicWallpaperReader()
  *
  * If the device is not already open, KDynamicWallpaperReader will attempt to open the device
  * in QIODevice::ReadOnly mode by calling open().
+ *
+ * If the device is a QFile, its contents will be mapped into memory rather than copied.
  */
 void KDynamicWallpaperReader::setDevice(QIODevice *device)
 {
-    if (d->device)
-        d->close();
+    d->close();
     d->device = device;
     d->isDeviceForeign = true;
     d->open();
@@ -291,13 +1244,58 @@ QIODevice *KDynamicWallpaperReader::device() const
  */
 void KDynamicWallpaperReader::setFileName(const QString &fileName)
 {
-    if (d->device)
-        d->close();
+    d->close();
     d->device = new QFile(fileName);
     d->isDeviceForeign = false;
     d->open();
 }
 
+/*!
+ * Sets the document of the reader to the specified \p document.
+ *
+ * The reader neither reads the file nor parses the metadata again, it only creates its own
+ * decoder. This makes it cheap to create a reader per thread in order to decode several images
+ * of the same wallpaper in parallel.
+ */
+void KDynamicWallpaperReader::setDocument(const KDynamicWallpaperDocument &document)
+{
+    d->close();
+    d->document = document;
+    d->open();
+}
+
+/*!
+ * Returns the document assigned to the reader, or a null document if no document has been
+ * assigned.
+ */
+KDynamicWallpaperDocument KDynamicWallpaperReader::document() const
+{
+    return d->document;
+}
+
+/*!
+ * Sets the encoded contents of the dynamic wallpaper to \p data.
+ *
+ * The reader decodes images straight from \p data, the byte array is not copied. Note that
+ * if \p data was created with QByteArray::fromRawData(), the underlying buffer must stay
+ * valid for the lifetime of the reader.
+ */
+void KDynamicWallpaperReader::setData(const QByteArray &data)
+{
+    d->close();
+    d->buffer = data;
+    d->open();
+}
+
+/*!
+ * Returns the encoded contents of the dynamic wallpaper if they have been set with setData();
+ * otherwise an empty QByteArray object is returned.
+ */
+QByteArray KDynamicWallpaperReader::data() const
+{
+    return d->device || !d->document.isNull() ? QByteArray() : d->buffer;
+}
+
 /*!
  * If the currently assigned device is a QFile, or if setFileName() has been called, this
  * function returns the name of the file KDynamicWallpaperReader reads from; otherwise an empty
@@ -305,6 +1303,8 @@ void KDynamicWallpaperReader::setFileName(const QString &fileName)
  */
 QString KDynamicWallpaperReader::fileName() const
 {
+    if (!d->document.isNull())
+        return d->document.fileName();
     const QFile *file = qobject_cast<QFile *>(d->device);
     return file ? file->fileName() : QString();
 }
@@ -314,7 +1314,15 @@ QString KDynamicWallpaperReader::fileName() const
  */
 int KDynamicWallpaperReader::imageCount() const
 {
-    return d->decoder->imageCount;
+    return d->imageCount;
+}
+
+/*!
+ * Returns the dimensions of the images in the dynamic wallpaper.
+ */
+QSize KDynamicWallpaperReader::imageSize() const
+{
+    return d->imageSize;
 }
 
 /*!
@@ -332,9 +1340,197 @@ QList<KDynamicWallpaperMetaData> KDynamicWallpaperReader::metaData() const
  */
 QImage KDynamicWallpaperReader::image(int imageIndex) const
 {
-    if (!d->decoder)
+    return image(imageIndex, QSize());
+}
+
+/*!
+ * Returns the image with the specified index \p imageIndex scaled to \p size. If \p size is
+ * empty, the image will be returned at its native size.
+ *
+ * Unlike scaling the full-size image with QImage::scaled(), the image is downscaled before
+ * the YUV to RGB conversion, so no full-size RGB image is ever allocated. If \p mode is
+ * Qt::FastTransformation, the chroma planes will be upsampled with the fastest available
+ * filter, which is useful for thumbnails and previews.
+ *
+ * This method will return a null QImage object if \p imageIndex is outside of the valid range.
+ */
+QImage KDynamicWallpaperReader::image(int imageIndex, const QSize &size, Qt::TransformationMode mode) const
+{
+    return image(imageIndex, QRect(), size, mode);
+}
+
+/*!
+ * Returns the area \p sourceRect of the image with the specified index \p imageIndex scaled
+ * to \p size. If \p sourceRect is null, the whole image will be returned. If \p size is empty,
+ * the area will be returned at its native size.
+ *
+ * Only the pixels inside \p sourceRect are scaled and converted to RGB, which is useful if the
+ * image is going to be cropped anyway, e.g. to fill a screen with a different aspect ratio.
+ *
+ * This method will return a null QImage object if \p imageIndex is outside of the valid range
+ * or if \p sourceRect doesn't intersect the image.
+ */
+QImage KDynamicWallpaperReader::image(int imageIndex, const QRect &sourceRect, const QSize &size, Qt::TransformationMode mode) const
+{
+    QImage image;
+    if (!read(imageIndex, &image, sourceRect, size, mode))
+        return QImage();
+    return image;
+}
+
+/*!
+ * Decodes the image with the specified index \p imageIndex into \p image and returns \c true
+ * on success; otherwise returns \c false.
+ *
+ * If \p image already has the requested size and the QImage::Format_RGB32 format, the decoded
+ * pixels are written into its buffer rather than a newly allocated one. Reusing the same
+ * QImage object for consecutive reads avoids allocating a full-size frame per read.
+ *
+ * \sa image()
+ */
+bool KDynamicWallpaperReader::read(int imageIndex, QImage *image, const QSize &size, Qt::TransformationMode mode) const
+{
+    return read(imageIndex, image, QRect(), size, mode);
+}
+
+/*!
+ * Decodes the area \p sourceRect of the image with the specified index \p imageIndex scaled
+ * to \p size into \p image and returns \c true on success; otherwise returns \c false.
+ *
+ * If \p imageIndex is outside of the valid range, the error is set to ReadError.
+ */
+bool KDynamicWallpaperReader::read(int imageIndex, QImage *image, const QRect &sourceRect, const QSize &size, Qt::TransformationMode mode) const
+{
+    if (!d->decoder) {
+        if (d->openMode == ReadMetaDataOnly && d->wallpaperReaderError == NoError) {
+            d->wallpaperReaderError = ReadError;
+            d->errorString = QStringLiteral("The reader has been opened in metadata-only mode");
+        }
+        return false;
+    }
+    if (imageIndex < 0 || imageIndex >= d->imageCount) {
+        d->wallpaperReaderError = ReadError;
+        d->errorString = QStringLiteral("Invalid image index %1").arg(imageIndex);
+        return false;
+    }
+    return d->fetch(imageIndex, sourceRect, size, mode, image);
+}
+
+/*!
+ * Returns \c true if the wallpaper contains embedded thumbnails; otherwise returns \c false.
+ *
+ * Thumbnails are available in both ReadImages and ReadMetaDataOnly modes.
+ *
+ * \sa thumbnail(), KDynamicWallpaperWriter::setThumbnailSize()
+ */
+bool KDynamicWallpaperReader::hasThumbnails() const
+{
+    return d->loadThumbnails();
+}
+
+/*!
+ * Returns the embedded thumbnail of the image with the specified index \p imageIndex. Decoding
+ * a thumbnail is much cheaper than decoding the full image, and only the thumbnail data is
+ * read from the device.
+ *
+ * This method will return a null QImage object if the wallpaper has no thumbnails or if
+ * \p imageIndex is outside of the valid range.
+ */
+QImage KDynamicWallpaperReader::thumbnail(int imageIndex) const
+{
+    if (!d->loadThumbnails())
+        return QImage();
+    return d->fetchThumbnail(imageIndex);
+}
+
+/*!
+ * Returns the index of the image that has been decoded most recently, or -1 if no image has
+ * been decoded yet.
+ */
+int KDynamicWallpaperReader::currentImageIndex() const
+{
+    return d->currentImageIndex();
+}
+
+/*!
+ * Decodes the image that follows the current image and returns it scaled to \p size. Returns
+ * a null QImage object after the last image has been read.
+ *
+ * Only one frame needs to be decoded per call, so visiting all images in the wallpaper with
+ * readNextImage() takes linear time.
+ *
+ * \sa currentImageIndex()
+ */
+QImage KDynamicWallpaperReader::readNextImage(const QSize &size, Qt::TransformationMode mode)
+{
+    const int nextIndex = currentImageIndex() + 1;
+    if (nextIndex >= d->imageCount)
         return QImage();
-    return d->fetch(imageIndex);
+    return image(nextIndex, size, mode);
+}
+
+/*!
+ * Returns the index of the nearest keyframe at or before the image with the specified index
+ * \p imageIndex, or -1 if \p imageIndex is outside of the valid range.
+ *
+ * Images in a dynamic wallpaper can be inter-predicted, decoding an image requires decoding
+ * all frames starting with its nearest keyframe. The keyframe index is only available if the
+ * reader has been opened in the ReadImages mode.
+ */
+int KDynamicWallpaperReader::nearestKeyframe(int imageIndex) const
+{
+    return d->nearestKeyframes.value(imageIndex, -1);
+}
+
+/*!
+ * Returns the estimated cost of decoding the image with the specified index \p imageIndex,
+ * expressed as the number of frames that need to be decoded, or -1 if \p imageIndex is outside
+ * of the valid range.
+ *
+ * The estimate takes the current position of the decoder into account. For example, the cost
+ * of the image that follows the current image is always 1, and the cost of the current image
+ * is 0.
+ */
+int KDynamicWallpaperReader::decodeCost(int imageIndex) const
+{
+    const int keyframe = nearestKeyframe(imageIndex);
+    if (keyframe == -1)
+        return -1;
+
+    const int currentIndex = currentImageIndex();
+    if (currentIndex >= keyframe && currentIndex <= imageIndex)
+        return imageIndex - currentIndex;
+    return imageIndex - keyframe + 1;
+}
+
+/*!
+ * \struct KDynamicWallpaperReader::Statistics
+ * \brief The Statistics struct describes where a KDynamicWallpaperReader has spent its time.
+ *
+ * All durations are measured in nanoseconds and accumulate from the moment a device, a file
+ * name, data or a document is assigned to the reader.
+ *
+ * \list
+ * \li ioTime is the time spent reading the device;
+ * \li containerParseTime is the time spent parsing the AVIF container;
+ * \li metaDataParseTime is the time spent parsing the XMP metadata;
+ * \li decodeTime is the time spent decoding AV1 frames;
+ * \li conversionTime is the time spent scaling images and converting them from YUV to RGB;
+ * \li bytesRead is the number of bytes read from the device;
+ * \li bytesMapped is the number of bytes mapped into memory;
+ * \li decodedFrameCount is the number of decoded AV1 frames, including the frames that had to
+ * be decoded in order to decode inter-predicted frames.
+ * \endlist
+ *
+ * The same numbers are logged to the \c kdynamicwallpaper logging category at the debug level.
+ */
+
+/*!
+ * Returns the statistics of the reader.
+ */
+KDynamicWallpaperReader::Statistics KDynamicWallpaperReader::statistics() const
+{
+    return d->statistics;
 }
 
 /*!
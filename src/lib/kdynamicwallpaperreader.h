@@ -7,9 +7,15 @@
 #pragma once
 
 #include "kdynamicwallpaper_export.h"
+#include "kdynamicwallpaperdocument.h"
 #include "kdynamicwallpapermetadata.h"
 
+#include <QFuture>
 #include <QIODevice>
+#include <QRect>
+#include <QSize>
+
+#include <optional>
 
 class KDynamicWallpaperReaderPrivate;
 
@@ -22,25 +28,88 @@ public:
         ReadError,
     };
 
+    enum OpenMode {
+        ReadImages,
+        ReadMetaDataOnly,
+    };
+
+    enum Priority {
+        LowPriority,
+        NormalPriority,
+    };
+
+    struct Statistics
+    {
+        qint64 ioTime = 0;
+        qint64 containerParseTime = 0;
+        qint64 metaDataParseTime = 0;
+        qint64 decodeTime = 0;
+        qint64 conversionTime = 0;
+        qint64 bytesRead = 0;
+        qint64 bytesMapped = 0;
+        int decodedFrameCount = 0;
+    };
+
     KDynamicWallpaperReader();
     explicit KDynamicWallpaperReader(QIODevice *device);
     explicit KDynamicWallpaperReader(const QString &fileName);
+    KDynamicWallpaperReader(QIODevice *device, OpenMode mode);
+    KDynamicWallpaperReader(const QString &fileName, OpenMode mode);
+    explicit KDynamicWallpaperReader(const KDynamicWallpaperDocument &document, OpenMode mode = ReadImages);
     ~KDynamicWallpaperReader();
 
+    void setOpenMode(OpenMode mode);
+    OpenMode openMode() const;
+
+    void setPriority(Priority priority);
+    Priority priority() const;
+
+    void setMaxThreadCount(int max);
+    std::optional<int> maxThreadCount() const;
+
     void setDevice(QIODevice *device);
     QIODevice *device() const;
 
     void setFileName(const QString &fileName);
     QString fileName() const;
 
+    void setData(const QByteArray &data);
+    QByteArray data() const;
+
+    void setDocument(const KDynamicWallpaperDocument &document);
+    KDynamicWallpaperDocument document() const;
+
     QList<KDynamicWallpaperMetaData> metaData() const;
 
     int imageCount() const;
+    QSize imageSize() const;
     QImage image(int imageIndex) const;
+    QImage image(int imageIndex, const QSize &size, Qt::TransformationMode mode = Qt::SmoothTransformation) const;
+    QImage image(int imageIndex, const QRect &sourceRect, const QSize &size, Qt::TransformationMode mode = Qt::SmoothTransformation) const;
+
+    bool read(int imageIndex, QImage *image, const QSize &size = QSize(), Qt::TransformationMode mode = Qt::SmoothTransformation) const;
+    bool read(int imageIndex, QImage *image, const QRect &sourceRect, const QSize &size, Qt::TransformationMode mode = Qt::SmoothTransformation) const;
+
+    bool hasThumbnails() const;
+    QImage thumbnail(int imageIndex) const;
+
+    int currentImageIndex() const;
+    QImage readNextImage(const QSize &size = QSize(), Qt::TransformationMode mode = Qt::SmoothTransformation);
+
+    int nearestKeyframe(int imageIndex) const;
+    int decodeCost(int imageIndex) const;
+
+    Statistics statistics() const;
 
     WallpaperReaderError error() const;
     QString errorString() const;
 
+    static QFuture<QImage> imageAsync(const QString &fileName, int imageIndex, const QSize &size = QSize(), Priority priority = NormalPriority);
+    static QFuture<QList<KDynamicWallpaperMetaData>> metaDataAsync(const QString &fileName, Priority priority = NormalPriority);
+
+    static void setGlobalMaxThreadCount(int max);
+    static int globalMaxThreadCount();
+
     static bool canRead(QIODevice *device);
     static bool canRead(const QString &fileName);
 
@@ -0,0 +1,75 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "kdynamicwallpaperthreadbudget_p.h"
+
+#include <QThread>
+
+#include <algorithm>
+
+/*!
+ * \class KDynamicWallpaperThreadBudget
+ * \brief The KDynamicWallpaperThreadBudget class limits the total number of decoder threads.
+ *
+ * Every decoder asks the budget for a number of threads before its codec is created and
+ * gives them back when it's destroyed. If several decoders exist at the same time, they share
+ * the budget rather than each of them spawning QThread::idealThreadCount() threads. A decoder
+ * always gets at least one thread, even if the budget is exhausted.
+ */
+
+Q_GLOBAL_STATIC(KDynamicWallpaperThreadBudget, s_threadBudget)
+
+KDynamicWallpaperThreadBudget::KDynamicWallpaperThreadBudget()
+    : m_capacity(QThread::idealThreadCount())
+{
+}
+
+/*!
+ * Returns the global KDynamicWallpaperThreadBudget object.
+ */
+KDynamicWallpaperThreadBudget *KDynamicWallpaperThreadBudget::self()
+{
+    return s_threadBudget;
+}
+
+/*!
+ * Sets the total number of threads that can be shared by decoders to \a capacity.
+ */
+void KDynamicWallpaperThreadBudget::setCapacity(int capacity)
+{
+    QMutexLocker locker(&m_mutex);
+    m_capacity = std::max(1, capacity);
+}
+
+/*!
+ * Returns the total number of threads that can be shared by decoders.
+ */
+int KDynamicWallpaperThreadBudget::capacity() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_capacity;
+}
+
+/*!
+ * Takes up to \a desired threads from the budget and returns the number of granted threads.
+ * The granted threads must be returned with release().
+ */
+int KDynamicWallpaperThreadBudget::acquire(int desired)
+{
+    QMutexLocker locker(&m_mutex);
+    const int granted = std::clamp(m_capacity - m_used, 1, std::max(1, desired));
+    m_used += granted;
+    return granted;
+}
+
+/*!
+ * Returns \a count threads back to the budget.
+ */
+void KDynamicWallpaperThreadBudget::release(int count)
+{
+    QMutexLocker locker(&m_mutex);
+    m_used -= count;
+}
@@ -0,0 +1,28 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <QMutex>
+
+class KDynamicWallpaperThreadBudget
+{
+public:
+    KDynamicWallpaperThreadBudget();
+
+    static KDynamicWallpaperThreadBudget *self();
+
+    void setCapacity(int capacity);
+    int capacity() const;
+
+    int acquire(int desired);
+    void release(int count);
+
+private:
+    mutable QMutex m_mutex;
+    int m_capacity;
+    int m_used = 0;
+};
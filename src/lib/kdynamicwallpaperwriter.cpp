@@ -5,16 +5,29 @@
  */
 
 #include "kdynamicwallpaperwriter.h"
+#include "kdynamicwallpapercontainer_p.h"
+#include "kdynamicwallpaperdebug_p.h"
 
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QImage>
+#include <QImageReader>
 #include <QJsonArray>
 #include <QJsonDocument>
+#include <QMutex>
 #include <QScopeGuard>
+#include <QSemaphore>
+#include <QSharedData>
 #include <QThread>
+#include <QThreadPool>
 
 #include <avif/avif.h>
 
+#include <memory>
+#include <vector>
+
 /*!
  * \class KDynamicWallpaperWriter
  * \brief The KDynamicWallpaperWriter class provides a convenient way for writing dynamic
@@ -25,20 +38,122 @@
  * readable description of what went wrong.
  */
 
+static const int s_defaultInFlightImageCount = 3;
+
+/*!
+ * \internal
+ *
+ * The KDynamicWallpaperYuvImagePool class keeps the avifImage objects that have been encoded
+ * so their planes can be reused for the next images, which usually have the same size.
+ */
+class KDynamicWallpaperYuvImagePool
+{
+public:
+    ~KDynamicWallpaperYuvImagePool();
+
+    avifImage *acquire(const QSize &size, int depth, avifPixelFormat format);
+    void release(avifImage *image);
+
+private:
+    QMutex m_mutex;
+    QList<avifImage *> m_images;
+};
+
+KDynamicWallpaperYuvImagePool::~KDynamicWallpaperYuvImagePool()
+{
+    for (avifImage *image : std::as_const(m_images))
+        avifImageDestroy(image);
+}
+
+avifImage *KDynamicWallpaperYuvImagePool::acquire(const QSize &size, int depth, avifPixelFormat format)
+{
+    avifImage *image = nullptr;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_images.isEmpty())
+            image = m_images.takeLast();
+    }
+
+    if (!image)
+        return avifImageCreate(size.width(), size.height(), depth, format);
+
+    if (image->width != uint32_t(size.width()) || image->height != uint32_t(size.height()) || image->depth != uint32_t(depth) || image->yuvFormat != format) {
+        avifImageFreePlanes(image, AVIF_PLANES_ALL);
+        image->width = size.width();
+        image->height = size.height();
+        image->depth = depth;
+        image->yuvFormat = format;
+    }
+    return image;
+}
+
+void KDynamicWallpaperYuvImagePool::release(avifImage *image)
+{
+    if (!image)
+        return;
+    QMutexLocker locker(&m_mutex);
+    m_images.append(image);
+}
+
+/*!
+ * \internal
+ *
+ * The KDynamicWallpaperPreparedImage struct holds an image that has been loaded and converted
+ * to YUV, but not encoded yet. The ready semaphore is released once the image is prepared.
+ */
+struct KDynamicWallpaperPreparedImage
+{
+    QSemaphore ready;
+    avifImage *image = nullptr;
+    avifImage *thumbnail = nullptr;
+    QByteArray cacheKey;
+    QByteArray item;
+    bool isCached = false;
+    QString errorString;
+    qint64 loadTime = 0;
+    qint64 conversionTime = 0;
+    qint64 encodeTime = 0;
+};
+
 class KDynamicWallpaperWriterPrivate
 {
 public:
     KDynamicWallpaperWriterPrivate();
 
     bool flush(QIODevice *device);
+    avifEncoder *createEncoder(int threadCount) const;
+    avifResult encodeItem(const avifImage *image, QByteArray *data) const;
+    QByteArray itemCacheKey(const QImage &image) const;
+    void prepareImage(const KDynamicWallpaperWriter::ImageView &view,
+                      const QByteArray &xmp,
+                      KDynamicWallpaperYuvImagePool *imagePool,
+                      KDynamicWallpaperYuvImagePool *thumbnailPool,
+                      KDynamicWallpaperPreparedImage *prepared) const;
 
     KDynamicWallpaperWriter::WallpaperWriterError wallpaperWriterError;
     QString errorString;
     QList<KDynamicWallpaperWriter::ImageView> images;
     QList<KDynamicWallpaperMetaData> metaData;
     std::optional<int> speed;
+    std::optional<int> quality;
+    std::optional<int> minQuantizer;
+    std::optional<int> maxQuantizer;
+    KDynamicWallpaperWriter::PixelFormat pixelFormat = KDynamicWallpaperWriter::Yuv444Format;
+    int bitDepth = 8;
+    KDynamicWallpaperWriter::YuvRange yuvRange = KDynamicWallpaperWriter::FullRange;
     std::optional<int> maxThreadCount;
+    std::optional<int> maxInFlightImageCount;
+    std::optional<int> keyframeInterval;
+    std::optional<int> tileRowsLog2;
+    std::optional<int> tileColumnsLog2;
+    bool autoTiling = false;
+    KDynamicWallpaperWriter::ItemCache *itemCache = nullptr;
+    int itemEncoderThreadCount = 1;
+    bool allIntra = false;
+    QSize thumbnailSize;
+    KDynamicWallpaperWriter::Layout layout = KDynamicWallpaperWriter::SequenceLayout;
     avifCodecChoice codecChoice = AVIF_CODEC_CHOICE_AUTO;
+    KDynamicWallpaperWriter::Statistics statistics;
 };
 
 KDynamicWallpaperWriterPrivate::KDynamicWallpaperWriterPrivate()
@@ -76,6 +191,267 @@ static QByteArray serializeMetaData(const QList<KDynamicWallpaperMetaData> &meta
     return xmp;
 }
 
+static avifPixelFormat toAvifPixelFormat(KDynamicWallpaperWriter::PixelFormat format)
+{
+    switch (format) {
+    case KDynamicWallpaperWriter::Yuv444Format:
+        return AVIF_PIXEL_FORMAT_YUV444;
+    case KDynamicWallpaperWriter::Yuv422Format:
+        return AVIF_PIXEL_FORMAT_YUV422;
+    case KDynamicWallpaperWriter::Yuv420Format:
+        return AVIF_PIXEL_FORMAT_YUV420;
+    }
+    Q_UNREACHABLE();
+}
+
+/*!
+ * \internal
+ *
+ * Finds the libavif layout of the pixels in the specified QImage \a format. Returns \c false
+ * if libavif cannot read such pixels as is. The alpha channel is ignored, so premultiplied
+ * formats are not accepted.
+ */
+static bool toAvifRgbFormat(QImage::Format format, avifRGBFormat *rgbFormat, uint32_t *depth)
+{
+    switch (format) {
+    case QImage::Format_RGB888:
+        *rgbFormat = AVIF_RGB_FORMAT_RGB;
+        *depth = 8;
+        return true;
+    case QImage::Format_BGR888:
+        *rgbFormat = AVIF_RGB_FORMAT_BGR;
+        *depth = 8;
+        return true;
+    case QImage::Format_RGBX8888:
+    case QImage::Format_RGBA8888:
+        *rgbFormat = AVIF_RGB_FORMAT_RGBA;
+        *depth = 8;
+        return true;
+    case QImage::Format_RGB32:
+    case QImage::Format_ARGB32:
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+        *rgbFormat = AVIF_RGB_FORMAT_BGRA;
+#else
+        *rgbFormat = AVIF_RGB_FORMAT_ARGB;
+#endif
+        *depth = 8;
+        return true;
+    case QImage::Format_RGBX64:
+    case QImage::Format_RGBA64:
+        *rgbFormat = AVIF_RGB_FORMAT_RGBA;
+        *depth = 16;
+        return true;
+    default:
+        return false;
+    }
+}
+
+/*!
+ * \internal
+ *
+ * Returns the specified \a image in a format whose pixels libavif can read as is. Images that
+ * are already in such a format are returned without a copy. Other images are converted to 16
+ * bit samples if more than 8 bits per sample are going to be encoded.
+ */
+static QImage toRgbImage(const QImage &image, int bitDepth)
+{
+    avifRGBFormat rgbFormat;
+    uint32_t rgbDepth;
+    if (toAvifRgbFormat(image.format(), &rgbFormat, &rgbDepth))
+        return image;
+    return image.convertToFormat(bitDepth > 8 ? QImage::Format_RGBX64 : QImage::Format_RGB888);
+}
+
+/*!
+ * \internal
+ *
+ * Converts the specified \a image to YUV. The pixels of the image are read in place, so the
+ * image must be in one of the formats accepted by toAvifRgbFormat().
+ */
+static avifResult convertToYuv(const QImage &image, avifImage *avif)
+{
+    avifRGBImage rgb;
+    avifRGBImageSetDefaults(&rgb, avif);
+
+    if (!toAvifRgbFormat(image.format(), &rgb.format, &rgb.depth))
+        return AVIF_RESULT_REFORMAT_FAILED;
+    rgb.ignoreAlpha = AVIF_TRUE;
+    rgb.rowBytes = image.bytesPerLine();
+    rgb.pixels = const_cast<uint8_t *>(image.constBits());
+
+    // TODO: color space
+
+    return avifImageRGBToYUV(avif, &rgb);
+}
+
+/*!
+ * \internal
+ *
+ * Returns the key of the encoded item with the specified source \a image in the item cache.
+ * The key also covers every setting that affects the encoded data, so changing any of them
+ * invalidates the cached items. Items carry neither the metadata nor their position, so the
+ * same image is shared by every position and survives changes of the metadata.
+ */
+QByteArray KDynamicWallpaperWriterPrivate::itemCacheKey(const QImage &image) const
+{
+    QByteArray settings;
+    QDataStream stream(&settings, QIODevice::WriteOnly);
+    stream << quint32(AVIF_VERSION)
+           << QByteArray(avifCodecName(codecChoice, AVIF_CODEC_FLAG_CAN_ENCODE))
+           << speed.value_or(-1) << quality.value_or(-1) << minQuantizer.value_or(-1) << maxQuantizer.value_or(-1)
+           << int(pixelFormat) << bitDepth << int(yuvRange)
+           << tileRowsLog2.value_or(-1) << tileColumnsLog2.value_or(-1) << autoTiling
+           << int(image.format()) << image.width() << image.height();
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(settings);
+
+    // Scanlines can be padded, the padding bytes are not part of the image.
+    const qsizetype scanLineSize = (qsizetype(image.width()) * image.depth() + 7) / 8;
+    for (int y = 0; y < image.height(); ++y)
+        hash.addData(QByteArrayView(image.constScanLine(y), scanLineSize));
+
+    return hash.result().toHex();
+}
+
+/*!
+ * \internal
+ *
+ * Loads the image \a view and converts it and its thumbnail to YUV. With the item layout, the
+ * image is also encoded, unless it has already been encoded and is in the item cache. This
+ * function is called from the worker threads, so it must not touch the writer state except
+ * for the settings.
+ */
+void KDynamicWallpaperWriterPrivate::prepareImage(const KDynamicWallpaperWriter::ImageView &view,
+                                                  const QByteArray &xmp,
+                                                  KDynamicWallpaperYuvImagePool *imagePool,
+                                                  KDynamicWallpaperYuvImagePool *thumbnailPool,
+                                                  KDynamicWallpaperPreparedImage *prepared) const
+{
+    QElapsedTimer timer;
+    timer.start();
+    const QImage source = view.data();
+    prepared->loadTime = timer.nsecsElapsed();
+    if (source.isNull()) {
+        prepared->errorString = QStringLiteral("Failed to read: %1").arg(view.key());
+        return;
+    }
+
+    timer.restart();
+    const QImage image = toRgbImage(source, bitDepth);
+
+    // Items can be reused only if every image is encoded independently.
+    if (itemCache && layout == KDynamicWallpaperWriter::ItemLayout) {
+        prepared->cacheKey = itemCacheKey(image);
+        prepared->item = itemCache->find(prepared->cacheKey);
+        prepared->isCached = !prepared->item.isEmpty();
+    }
+
+    avifResult result = AVIF_RESULT_OK;
+    if (!prepared->isCached) {
+        prepared->image = imagePool->acquire(image.size(), bitDepth, toAvifPixelFormat(pixelFormat));
+        prepared->image->yuvRange = yuvRange == KDynamicWallpaperWriter::LimitedRange ? AVIF_RANGE_LIMITED : AVIF_RANGE_FULL;
+        // The XMP packet of a reused image is usually already in place.
+        if (prepared->image->xmp.size != size_t(xmp.size()))
+            avifImageSetMetadataXMP(prepared->image, reinterpret_cast<const uint8_t *>(xmp.constData()), xmp.size());
+
+        result = convertToYuv(image, prepared->image);
+    }
+    if (result == AVIF_RESULT_OK && thumbnailSize.isValid()) {
+        const QImage thumbnail = toRgbImage(image.scaled(thumbnailSize, Qt::KeepAspectRatio, Qt::SmoothTransformation), 8);
+        prepared->thumbnail = thumbnailPool->acquire(thumbnail.size(), 8, AVIF_PIXEL_FORMAT_YUV420);
+        result = convertToYuv(thumbnail, prepared->thumbnail);
+    }
+    prepared->conversionTime = timer.nsecsElapsed();
+
+    if (result != AVIF_RESULT_OK) {
+        prepared->errorString = QStringLiteral("Failed to convert %1: %2")
+                                    .arg(view.key())
+                                    .arg(QString::fromLatin1(avifResultToString(result)));
+        return;
+    }
+
+    // Independent images don't depend on each other, so they are encoded right here, in
+    // parallel with the other worker threads.
+    if (layout == KDynamicWallpaperWriter::ItemLayout && !prepared->isCached) {
+        timer.restart();
+        result = encodeItem(prepared->image, &prepared->item);
+        prepared->encodeTime = timer.nsecsElapsed();
+
+        imagePool->release(prepared->image);
+        prepared->image = nullptr;
+
+        if (result != AVIF_RESULT_OK) {
+            prepared->errorString = QStringLiteral("Failed to encode %1: %2")
+                                        .arg(view.key())
+                                        .arg(QString::fromLatin1(avifResultToString(result)));
+        }
+    }
+}
+
+avifEncoder *KDynamicWallpaperWriterPrivate::createEncoder(int threadCount) const
+{
+    avifEncoder *encoder = avifEncoderCreate();
+    encoder->codecChoice = codecChoice;
+    encoder->speed = speed.value_or(AVIF_SPEED_DEFAULT);
+    encoder->maxThreads = threadCount;
+    encoder->keyframeInterval = keyframeInterval.value_or(0);
+#if AVIF_VERSION >= 1000000
+    if (quality)
+        encoder->quality = *quality;
+    if (minQuantizer)
+        encoder->minQuantizer = *minQuantizer;
+    if (maxQuantizer)
+        encoder->maxQuantizer = *maxQuantizer;
+#else
+    if (quality) {
+        // Older versions of libavif only understand quantizers, 0 is lossless and 63 is the worst.
+        // The quality takes precedence over the quantizer range.
+        encoder->minQuantizer = ((100 - *quality) * AVIF_QUANTIZER_WORST_QUALITY + 50) / 100;
+        encoder->maxQuantizer = encoder->minQuantizer;
+    } else {
+        if (minQuantizer)
+            encoder->minQuantizer = *minQuantizer;
+        if (maxQuantizer)
+            encoder->maxQuantizer = *maxQuantizer;
+    }
+#endif
+    if (tileRowsLog2)
+        encoder->tileRowsLog2 = *tileRowsLog2;
+    if (tileColumnsLog2)
+        encoder->tileColsLog2 = *tileColumnsLog2;
+#if AVIF_VERSION >= 1000000
+    encoder->autoTiling = autoTiling;
+#endif
+    return encoder;
+}
+
+/*!
+ * \internal
+ *
+ * Encodes the specified \a image as a standalone AVIF file and stores the result in \a data.
+ * Several images can be encoded at the same time, so the encoder gets only a share of the
+ * maximum number of threads.
+ */
+avifResult KDynamicWallpaperWriterPrivate::encodeItem(const avifImage *image, QByteArray *data) const
+{
+    avifEncoder *encoder = createEncoder(itemEncoderThreadCount);
+    auto encoderCleanup = qScopeGuard([&encoder]() {
+        avifEncoderDestroy(encoder);
+    });
+
+    avifResult result = avifEncoderAddImage(encoder, image, 1, AVIF_ADD_IMAGE_FLAG_SINGLE);
+    if (result != AVIF_RESULT_OK)
+        return result;
+
+    avifRWData output = AVIF_DATA_EMPTY;
+    result = avifEncoderFinish(encoder, &output);
+    if (result == AVIF_RESULT_OK)
+        *data = QByteArray(reinterpret_cast<const char *>(output.data), output.size);
+    avifRWDataFree(&output);
+    return result;
+}
+
 bool KDynamicWallpaperWriterPrivate::flush(QIODevice *device)
 {
     if (metaData.isEmpty()) {
@@ -90,70 +466,324 @@ bool KDynamicWallpaperWriterPrivate::flush(QIODevice *device)
         return false;
     }
 
+    if (bitDepth != 8 && bitDepth != 10 && bitDepth != 12) {
+        wallpaperWriterError = KDynamicWallpaperWriter::EncoderError;
+        errorString = QStringLiteral("Unsupported bit depth: %1").arg(bitDepth);
+        return false;
+    }
+
+    statistics = KDynamicWallpaperWriter::Statistics();
+    QElapsedTimer timer;
+
+    const int threadCount = maxThreadCount.value_or(QThread::idealThreadCount());
+
     const QByteArray xmp = serializeMetaData(metaData);
-    avifEncoder *encoder = avifEncoderCreate();
-    encoder->codecChoice = codecChoice;
-    encoder->speed = speed.value_or(AVIF_SPEED_DEFAULT);
-    encoder->maxThreads = maxThreadCount.value_or(QThread::idealThreadCount());
+    // With the item layout, the images are encoded by the worker threads, one encoder per image.
+    avifEncoder *encoder = nullptr;
+    if (layout == KDynamicWallpaperWriter::SequenceLayout)
+        encoder = createEncoder(threadCount);
     auto encoderCleanup = qScopeGuard([&encoder]() {
-        avifEncoderDestroy(encoder);
+        if (encoder)
+            avifEncoderDestroy(encoder);
     });
 
-    for (const auto &view : images) {
-        const QImage image = view.data().convertToFormat(QImage::Format_RGB888);
-        if (image.isNull()) {
-            wallpaperWriterError = KDynamicWallpaperWriter::UnknownError;
-            errorString = QStringLiteral("Failed to read: %1").arg(view.key());
-            return false;
+    // Thumbnails are tiny, so they are encoded as an independent image sequence where every
+    // frame is a keyframe. This way, a single thumbnail can be decoded without touching others.
+    avifEncoder *thumbnailEncoder = nullptr;
+    if (thumbnailSize.isValid()) {
+        thumbnailEncoder = avifEncoderCreate();
+        thumbnailEncoder->codecChoice = codecChoice;
+        thumbnailEncoder->speed = AVIF_SPEED_FASTEST;
+        thumbnailEncoder->maxThreads = threadCount;
+    }
+    auto thumbnailEncoderCleanup = qScopeGuard([&thumbnailEncoder]() {
+        if (thumbnailEncoder)
+            avifEncoderDestroy(thumbnailEncoder);
+    });
+
+    // With the item layout, every in-flight image is encoded by its own encoder. The encoders
+    // scale better when each of them has a few threads rather than all of them.
+    int defaultInFlightImageCount = s_defaultInFlightImageCount;
+    if (layout == KDynamicWallpaperWriter::ItemLayout)
+        defaultInFlightImageCount = qMax(defaultInFlightImageCount, threadCount / 4);
+
+    const int inFlightImageCount = qBound(1, maxInFlightImageCount.value_or(defaultInFlightImageCount), int(images.size()));
+    itemEncoderThreadCount = qMax(1, threadCount / inFlightImageCount);
+
+    // The source images are loaded and converted to YUV on a small pool of threads while the
+    // encoder works through the previous frames. The next image is scheduled only after a
+    // prepared one has been encoded, so no more than inFlightImageCount frames are alive.
+    KDynamicWallpaperYuvImagePool imagePool;
+    KDynamicWallpaperYuvImagePool thumbnailPool;
+    std::vector<std::unique_ptr<KDynamicWallpaperPreparedImage>> preparedImages(images.size());
+    auto preparedImagesCleanup = qScopeGuard([&]() {
+        for (const auto &prepared : preparedImages) {
+            if (prepared) {
+                imagePool.release(prepared->image);
+                thumbnailPool.release(prepared->thumbnail);
+            }
         }
+    });
+
+    // The pending tasks must be finished before anything they refer to goes out of scope.
+    QThreadPool preparePool;
+    preparePool.setMaxThreadCount(inFlightImageCount);
+    auto preparePoolCleanup = qScopeGuard([&preparePool]() {
+        preparePool.clear();
+        preparePool.waitForDone();
+    });
 
-        avifImage *avif = avifImageCreate(image.width(), image.height(), 8, AVIF_PIXEL_FORMAT_YUV444);
-        avifImageSetMetadataXMP(avif, reinterpret_cast<const uint8_t *>(xmp.constData()), xmp.size());
+    const auto schedule = [&](int index) {
+        KDynamicWallpaperPreparedImage *prepared = new KDynamicWallpaperPreparedImage;
+        preparedImages[index].reset(prepared);
+        // With the item layout, the metadata is stored in the extension box rather than in the
+        // primary image, so the encoded images don't depend on the metadata.
+        const QByteArray imageXmp = layout == KDynamicWallpaperWriter::ItemLayout ? QByteArray() : xmp;
+        preparePool.start([this, prepared, &view = images.at(index), &imagePool, &thumbnailPool, imageXmp]() {
+            prepareImage(view, imageXmp, &imagePool, &thumbnailPool, prepared);
+            prepared->ready.release();
+        });
+    };
 
-        avifRGBImage rgb;
-        avifRGBImageSetDefaults(&rgb, avif);
+    for (int i = 0; i < inFlightImageCount; ++i)
+        schedule(i);
 
-        rgb.format = AVIF_RGB_FORMAT_RGB;
-        rgb.depth = 8;
-        rgb.rowBytes = image.bytesPerLine();
-        rgb.pixels = const_cast<uint8_t *>(image.constBits());
+    KDynamicWallpaperContainer::Extension extension;
+    QByteArray primaryItem;
+    if (layout == KDynamicWallpaperWriter::ItemLayout)
+        extension.xmp = xmp;
 
-        // TODO: color space
+    for (int i = 0; i < images.size(); ++i) {
+        KDynamicWallpaperPreparedImage *prepared = preparedImages[i].get();
+        prepared->ready.acquire();
 
-        avifResult result = avifImageRGBToYUV(avif, &rgb);
-        if (result != AVIF_RESULT_OK) {
+        statistics.loadTime += prepared->loadTime;
+        statistics.conversionTime += prepared->conversionTime;
+        if (!prepared->errorString.isEmpty()) {
             wallpaperWriterError = KDynamicWallpaperWriter::UnknownError;
-            errorString = QStringLiteral("Failed to encode %1: %2")
-                              .arg(view.key())
-                              .arg(QString::fromLatin1(avifResultToString(result)));
+            errorString = prepared->errorString;
             return false;
         }
 
-        result = avifEncoderAddImage(encoder, avif, 0, AVIF_ADD_IMAGE_FLAG_NONE);
+        timer.start();
+        avifResult result;
+        if (layout == KDynamicWallpaperWriter::ItemLayout) {
+            // The image has already been encoded by the worker thread.
+            result = AVIF_RESULT_OK;
+            statistics.encodeTime += prepared->encodeTime;
+            if (prepared->isCached)
+                ++statistics.cachedImageCount;
+            else if (itemCache)
+                itemCache->insert(prepared->cacheKey, prepared->item);
+
+            if (i == 0)
+                primaryItem = prepared->item;
+            else
+                extension.frames.append(prepared->item);
+        } else {
+            const avifAddImageFlags flags = allIntra ? AVIF_ADD_IMAGE_FLAG_FORCE_KEYFRAME : AVIF_ADD_IMAGE_FLAG_NONE;
+            result = avifEncoderAddImage(encoder, prepared->image, 0, flags);
+        }
+        statistics.encodeTime += timer.nsecsElapsed();
         if (result != AVIF_RESULT_OK) {
             wallpaperWriterError = KDynamicWallpaperWriter::UnknownError;
             errorString = QStringLiteral("Failed to encode %1: %2")
-                              .arg(view.key())
+                              .arg(images.at(i).key())
                               .arg(QString::fromLatin1(avifResultToString(result)));
             return false;
         }
+        if (!prepared->isCached)
+            ++statistics.encodedImageCount;
+
+        if (thumbnailEncoder) {
+            timer.restart();
+            result = avifEncoderAddImage(thumbnailEncoder, prepared->thumbnail, 0, AVIF_ADD_IMAGE_FLAG_FORCE_KEYFRAME);
+            statistics.encodeTime += timer.nsecsElapsed();
+            if (result != AVIF_RESULT_OK) {
+                wallpaperWriterError = KDynamicWallpaperWriter::UnknownError;
+                errorString = QStringLiteral("Failed to encode the thumbnail of %1: %2")
+                                  .arg(images.at(i).key())
+                                  .arg(QString::fromLatin1(avifResultToString(result)));
+                return false;
+            }
+        }
+
+        // The encoder keeps its own copy of the frame, so the planes can be filled with the
+        // next image right away.
+        imagePool.release(prepared->image);
+        thumbnailPool.release(prepared->thumbnail);
+        preparedImages[i].reset();
+
+        if (i + inFlightImageCount < images.size())
+            schedule(i + inFlightImageCount);
+    }
 
-        avifImageDestroy(avif);
+    if (thumbnailEncoder) {
+        avifRWData thumbnails = AVIF_DATA_EMPTY;
+        timer.restart();
+        const avifResult result = avifEncoderFinish(thumbnailEncoder, &thumbnails);
+        statistics.encodeTime += timer.nsecsElapsed();
+        if (result != AVIF_RESULT_OK) {
+            wallpaperWriterError = KDynamicWallpaperWriter::EncoderError;
+            errorString = QString::fromLatin1(avifResultToString(result));
+            return false;
+        }
+        extension.thumbnails = QByteArray(reinterpret_cast<const char *>(thumbnails.data), thumbnails.size);
+        avifRWDataFree(&thumbnails);
     }
 
     avifRWData output = AVIF_DATA_EMPTY;
-    avifResult result = avifEncoderFinish(encoder, &output);
-    if (result == AVIF_RESULT_OK) {
-        device->write(reinterpret_cast<const char *>(output.data), output.size);
-    } else {
-        wallpaperWriterError = KDynamicWallpaperWriter::EncoderError;
-        errorString = QString::fromLatin1(avifResultToString(result));
+    auto outputCleanup = qScopeGuard([&output]() {
+        avifRWDataFree(&output);
+    });
+
+    QByteArrayView primary = primaryItem;
+    if (layout == KDynamicWallpaperWriter::SequenceLayout) {
+        timer.restart();
+        const avifResult result = avifEncoderFinish(encoder, &output);
+        statistics.encodeTime += timer.nsecsElapsed();
+        if (result != AVIF_RESULT_OK) {
+            wallpaperWriterError = KDynamicWallpaperWriter::EncoderError;
+            errorString = QString::fromLatin1(avifResultToString(result));
+            return false;
+        }
+        primary = QByteArrayView(output.data, output.size);
     }
 
-    avifRWDataFree(&output);
+    timer.restart();
+    statistics.bytesWritten += device->write(primary.data(), primary.size());
+    // The extension box follows the boxes written by libavif, so the item locations in the
+    // meta box stay valid. Readers that don't know about the extension skip it.
+    if (!extension.xmp.isEmpty() || !extension.thumbnails.isEmpty() || !extension.frames.isEmpty())
+        statistics.bytesWritten += device->write(KDynamicWallpaperContainer::createExtensionBox(extension));
+    statistics.writeTime += timer.nsecsElapsed();
+
+    qCDebug(KDYNAMICWALLPAPER, "Wrote %d images (%d cached): load %.2fms, conversion %.2fms, encode %.2fms, write %.2fms, %lld bytes",
+            statistics.encodedImageCount + statistics.cachedImageCount, statistics.cachedImageCount, statistics.loadTime / 1e6, statistics.conversionTime / 1e6,
+            statistics.encodeTime / 1e6, statistics.writeTime / 1e6, statistics.bytesWritten);
+
     return true;
 }
 
+/*!
+ * \class KDynamicWallpaperWriter::ImageView
+ * \brief The ImageView class provides a source image for KDynamicWallpaperWriter.
+ *
+ * An image view can refer to an image file, an in-memory QImage, a QIODevice or a generator
+ * function. Except for in-memory images, the image is loaded only when the writer is about to
+ * encode it, so a wallpaper with many images can be written without keeping them all in memory.
+ *
+ * Images are loaded on worker threads. A device must not be used by anything else while the
+ * wallpaper is being written, and a generator function must be safe to call from any thread.
+ *
+ * If the image is in the QImage::Format_RGB888, QImage::Format_BGR888, QImage::Format_RGB32,
+ * QImage::Format_ARGB32, QImage::Format_RGBX8888, QImage::Format_RGBA8888, QImage::Format_RGBX64
+ * or QImage::Format_RGBA64 format, its pixels are converted to YUV in place. Images in other
+ * formats are copied first. The alpha channel is ignored.
+ *
+ * The key identifies the image in error messages.
+ */
+
+class KDynamicWallpaperImageViewPrivate : public QSharedData
+{
+public:
+    QString key;
+    QString fileName;
+    QImage image;
+    QIODevice *device = nullptr;
+    KDynamicWallpaperWriter::ImageView::Generator generator;
+};
+
+/*!
+ * Constructs an image view for the image file \a fileName. The file name is used as the key.
+ */
+KDynamicWallpaperWriter::ImageView::ImageView(const QString &fileName)
+    : d(new KDynamicWallpaperImageViewPrivate)
+{
+    d->key = fileName;
+    d->fileName = fileName;
+}
+
+/*!
+ * Constructs an image view for the in-memory \a image with the specified \a key.
+ */
+KDynamicWallpaperWriter::ImageView::ImageView(const QImage &image, const QString &key)
+    : d(new KDynamicWallpaperImageViewPrivate)
+{
+    d->key = key;
+    d->image = image;
+}
+
+/*!
+ * Constructs an image view for the image stored in \a device with the specified \a key. The
+ * view doesn't take the ownership of the device.
+ */
+KDynamicWallpaperWriter::ImageView::ImageView(QIODevice *device, const QString &key)
+    : d(new KDynamicWallpaperImageViewPrivate)
+{
+    d->key = key;
+    d->device = device;
+}
+
+/*!
+ * Constructs an image view for the image produced by \a generator with the specified \a key.
+ */
+KDynamicWallpaperWriter::ImageView::ImageView(const Generator &generator, const QString &key)
+    : d(new KDynamicWallpaperImageViewPrivate)
+{
+    d->key = key;
+    d->generator = generator;
+}
+
+/*!
+ * Constructs a copy of the \a other image view.
+ */
+KDynamicWallpaperWriter::ImageView::ImageView(const ImageView &other)
+    : d(other.d)
+{
+}
+
+/*!
+ * Destructs the ImageView object.
+ */
+KDynamicWallpaperWriter::ImageView::~ImageView()
+{
+}
+
+/*!
+ * Assigns the value of \a other to the image view.
+ */
+KDynamicWallpaperWriter::ImageView &KDynamicWallpaperWriter::ImageView::operator=(const ImageView &other)
+{
+    d = other.d;
+    return *this;
+}
+
+/*!
+ * Loads the image and returns it. A null image is returned if the image cannot be loaded.
+ */
+QImage KDynamicWallpaperWriter::ImageView::data() const
+{
+    if (d->generator)
+        return d->generator();
+    if (d->device) {
+        if (!d->device->isSequential())
+            d->device->seek(0);
+        return QImageReader(d->device).read();
+    }
+    if (!d->fileName.isEmpty())
+        return QImage(d->fileName);
+    return d->image;
+}
+
+/*!
+ * Returns the key of the image.
+ */
+QString KDynamicWallpaperWriter::ImageView::key() const
+{
+    return d->key;
+}
+
 /*!
  * Constructs an empty KDynamicWallpaperWriter object.
  */
@@ -188,6 +818,117 @@ std::optional<int> KDynamicWallpaperWriter::speed() const
     return d->speed;
 }
 
+/*!
+ * Sets the quality of the encoded images to \a quality. The quality value must be between 0 and
+ * 100, where 0 is the worst quality, and 100 is lossless. If a quality is set, it takes
+ * precedence over the quantizer range, see setMinQuantizer() and setMaxQuantizer().
+ */
+void KDynamicWallpaperWriter::setQuality(int quality)
+{
+    d->quality = qBound(0, quality, 100);
+}
+
+/*!
+ * Returns the quality of the encoded images, between 0-100. If the quality is not set, the
+ * encoder will use its default quality.
+ */
+std::optional<int> KDynamicWallpaperWriter::quality() const
+{
+    return d->quality;
+}
+
+/*!
+ * Sets the lowest quantizer the encoder is allowed to use to \a quantizer. The quantizer value
+ * must be between 0 and 63, where 0 is lossless, and 63 is the worst quality.
+ *
+ * With libavif older than 1.0, the quantizer range is ignored if a quality is set.
+ */
+void KDynamicWallpaperWriter::setMinQuantizer(int quantizer)
+{
+    d->minQuantizer = qBound(0, quantizer, 63);
+}
+
+/*!
+ * Returns the lowest quantizer the encoder is allowed to use.
+ */
+std::optional<int> KDynamicWallpaperWriter::minQuantizer() const
+{
+    return d->minQuantizer;
+}
+
+/*!
+ * Sets the highest quantizer the encoder is allowed to use to \a quantizer. The quantizer
+ * value must be between 0 and 63, where 0 is lossless, and 63 is the worst quality.
+ *
+ * With libavif older than 1.0, the quantizer range is ignored if a quality is set.
+ */
+void KDynamicWallpaperWriter::setMaxQuantizer(int quantizer)
+{
+    d->maxQuantizer = qBound(0, quantizer, 63);
+}
+
+/*!
+ * Returns the highest quantizer the encoder is allowed to use.
+ */
+std::optional<int> KDynamicWallpaperWriter::maxQuantizer() const
+{
+    return d->maxQuantizer;
+}
+
+/*!
+ * Sets the pixel format of the encoded images to \a format. The default is Yuv444Format.
+ *
+ * With Yuv420Format, the chroma planes have a quarter of the resolution of the luma plane.
+ * For photographs, this is rarely noticeable, while both the file size and the time it takes
+ * to decode an image drop considerably.
+ */
+void KDynamicWallpaperWriter::setPixelFormat(PixelFormat format)
+{
+    d->pixelFormat = format;
+}
+
+/*!
+ * Returns the pixel format of the encoded images.
+ */
+KDynamicWallpaperWriter::PixelFormat KDynamicWallpaperWriter::pixelFormat() const
+{
+    return d->pixelFormat;
+}
+
+/*!
+ * Sets the number of bits per sample of the encoded images to \a depth. Supported values are
+ * 8, 10 and 12. The default is 8.
+ */
+void KDynamicWallpaperWriter::setBitDepth(int depth)
+{
+    d->bitDepth = depth;
+}
+
+/*!
+ * Returns the number of bits per sample of the encoded images.
+ */
+int KDynamicWallpaperWriter::bitDepth() const
+{
+    return d->bitDepth;
+}
+
+/*!
+ * Sets the range of the YUV samples of the encoded images to \a range. The default is
+ * FullRange.
+ */
+void KDynamicWallpaperWriter::setYuvRange(YuvRange range)
+{
+    d->yuvRange = range;
+}
+
+/*!
+ * Returns the range of the YUV samples of the encoded images.
+ */
+KDynamicWallpaperWriter::YuvRange KDynamicWallpaperWriter::yuvRange() const
+{
+    return d->yuvRange;
+}
+
 void KDynamicWallpaperWriter::setMetaData(const QList<KDynamicWallpaperMetaData> &metaData)
 {
     d->metaData = metaData;
@@ -258,6 +999,216 @@ std::optional<int> KDynamicWallpaperWriter::maxThreadCount() const
     return d->maxThreadCount;
 }
 
+/*!
+ * Sets the layout of the images in the wallpaper file to \a layout.
+ *
+ * With the SequenceLayout layout, which is the default, the images are stored as an AV1 image
+ * sequence. Consecutive images are usually similar, so the images can be inter-predicted and
+ * the file is small, but decoding an image may require decoding other images first.
+ *
+ * With the ItemLayout layout, every image is encoded as an independent AVIF image. Any image
+ * can be decoded without touching the other images, and several images can be decoded in
+ * parallel, at the cost of a bigger file. The first image is the primary image of the file,
+ * so applications that are not aware of dynamic wallpapers will show it. The metadata is kept
+ * in the extension box next to the other images.
+ */
+void KDynamicWallpaperWriter::setLayout(Layout layout)
+{
+    d->layout = layout;
+}
+
+/*!
+ * Returns the layout of the images in the wallpaper file.
+ */
+KDynamicWallpaperWriter::Layout KDynamicWallpaperWriter::layout() const
+{
+    return d->layout;
+}
+
+/*!
+ * Sets the maximum distance between two keyframes to \a interval. A reader has to decode all
+ * frames since the nearest keyframe to get an image, so a shorter interval makes access to an
+ * arbitrary image faster at the cost of a bigger file.
+ *
+ * If not set, or if the interval is 0, the encoder will place keyframes at its will.
+ */
+void KDynamicWallpaperWriter::setKeyframeInterval(int interval)
+{
+    d->keyframeInterval = qMax(0, interval);
+}
+
+/*!
+ * Returns the maximum distance between two keyframes. If nullopt is returned, the encoder is
+ * free to choose where to place keyframes.
+ */
+std::optional<int> KDynamicWallpaperWriter::keyframeInterval() const
+{
+    return d->keyframeInterval;
+}
+
+/*!
+ * Sets whether every image must be encoded as a keyframe to \a allIntra. In that case, any
+ * image can be decoded without decoding other images, but the file is significantly bigger.
+ *
+ * The default value is \c false.
+ */
+void KDynamicWallpaperWriter::setAllIntra(bool allIntra)
+{
+    d->allIntra = allIntra;
+}
+
+/*!
+ * Returns \c true if every image will be encoded as a keyframe; otherwise returns \c false.
+ */
+bool KDynamicWallpaperWriter::isAllIntra() const
+{
+    return d->allIntra;
+}
+
+/*!
+ * Sets the base 2 logarithm of the number of tile rows to \a rows. The value must be between
+ * 0 and 6.
+ *
+ * Tiles are decoded in parallel, so splitting large images into several tiles lets readers
+ * use more threads when decoding an image, at the cost of a slightly bigger file.
+ *
+ * \sa setAutoTiling()
+ */
+void KDynamicWallpaperWriter::setTileRowsLog2(int rows)
+{
+    d->tileRowsLog2 = qBound(0, rows, 6);
+}
+
+/*!
+ * Returns the base 2 logarithm of the number of tile rows. If nullopt is returned, the images
+ * are encoded as a single tile row unless automatic tiling is enabled.
+ */
+std::optional<int> KDynamicWallpaperWriter::tileRowsLog2() const
+{
+    return d->tileRowsLog2;
+}
+
+/*!
+ * Sets the base 2 logarithm of the number of tile columns to \a columns. The value must be
+ * between 0 and 6.
+ *
+ * \sa setTileRowsLog2(), setAutoTiling()
+ */
+void KDynamicWallpaperWriter::setTileColumnsLog2(int columns)
+{
+    d->tileColumnsLog2 = qBound(0, columns, 6);
+}
+
+/*!
+ * Returns the base 2 logarithm of the number of tile columns. If nullopt is returned, the
+ * images are encoded as a single tile column unless automatic tiling is enabled.
+ */
+std::optional<int> KDynamicWallpaperWriter::tileColumnsLog2() const
+{
+    return d->tileColumnsLog2;
+}
+
+/*!
+ * Sets whether the number of tiles should be chosen by the encoder based on the image size and
+ * the maximum number of threads to \a enabled. If automatic tiling is enabled, the values set
+ * with setTileRowsLog2() and setTileColumnsLog2() are ignored.
+ *
+ * Automatic tiling requires libavif 1.0 or newer. The default value is \c false.
+ */
+void KDynamicWallpaperWriter::setAutoTiling(bool enabled)
+{
+    d->autoTiling = enabled;
+}
+
+/*!
+ * Returns \c true if the number of tiles is chosen by the encoder; otherwise returns \c false.
+ */
+bool KDynamicWallpaperWriter::autoTiling() const
+{
+    return d->autoTiling;
+}
+
+/*!
+ * \class KDynamicWallpaperWriter::ItemCache
+ * \brief The ItemCache class provides an interface for storing encoded images between writes.
+ *
+ * With the ItemLayout layout, every image is encoded independently and the metadata is stored
+ * separately, so an encoded image can be reused as long as neither the image nor the encoder
+ * settings have changed. The writer computes a key that covers both and asks the cache for the
+ * encoded image before encoding it.
+ *
+ * find() returns the encoded image with the specified key, or an empty QByteArray if there is
+ * none. It's called from the worker threads of the writer, so it must be thread-safe. insert()
+ * is called after an image has been encoded.
+ */
+
+/*!
+ * Sets the cache of encoded images to \a cache. The cache is only used with the ItemLayout
+ * layout. The writer doesn't take the ownership of the cache.
+ *
+ * Changing an image of a wallpaper then only requires encoding the changed image, and changing
+ * only the metadata requires no encoding at all. With the SequenceLayout layout, the images are
+ * inter-predicted, so the cache can't be used and every image is encoded again.
+ */
+void KDynamicWallpaperWriter::setItemCache(ItemCache *cache)
+{
+    d->itemCache = cache;
+}
+
+/*!
+ * Returns the cache of encoded images, or \c nullptr if no cache has been set.
+ */
+KDynamicWallpaperWriter::ItemCache *KDynamicWallpaperWriter::itemCache() const
+{
+    return d->itemCache;
+}
+
+/*!
+ * Sets the maximum number of images that can be loaded and converted to YUV ahead of the
+ * encoder to \a max. The images are prepared in parallel while the encoder is busy, so a
+ * higher number can speed up writing at the cost of higher peak memory usage.
+ *
+ * With the ItemLayout layout, the images are also encoded in parallel, one encoder per image
+ * in flight, and the maximum number of threads is split between the encoders.
+ *
+ * If not set, at most 3 images will be in flight. With the ItemLayout layout, the default is
+ * raised so that every encoder gets about 4 threads.
+ */
+void KDynamicWallpaperWriter::setMaxInFlightImageCount(int max)
+{
+    d->maxInFlightImageCount = qMax(1, max);
+}
+
+/*!
+ * Returns the maximum number of images that can be prepared ahead of the encoder. If nullopt
+ * is returned, the writer will use the default value.
+ */
+std::optional<int> KDynamicWallpaperWriter::maxInFlightImageCount() const
+{
+    return d->maxInFlightImageCount;
+}
+
+/*!
+ * Sets the maximum size of the embedded thumbnails to \a size. The thumbnails preserve the
+ * aspect ratio of the wallpaper images. If the size is not valid, which is the default, no
+ * thumbnails will be embedded in the wallpaper.
+ *
+ * Thumbnails let applications show a preview of the wallpaper without decoding the full
+ * resolution images.
+ */
+void KDynamicWallpaperWriter::setThumbnailSize(const QSize &size)
+{
+    d->thumbnailSize = size;
+}
+
+/*!
+ * Returns the maximum size of the embedded thumbnails.
+ */
+QSize KDynamicWallpaperWriter::thumbnailSize() const
+{
+    return d->thumbnailSize;
+}
+
 /*!
  * Begins a write sequence to the device and returns \c true if successful; otherwise \c false is
  * returned. You must call this method before calling write() method.
@@ -303,6 +1254,38 @@ bool KDynamicWallpaperWriter::flush(const QString &fileName)
     return d->flush(&file);
 }
 
+/*!
+ * \struct KDynamicWallpaperWriter::Statistics
+ * \brief The Statistics struct describes where a KDynamicWallpaperWriter has spent its time
+ * during the last flush().
+ *
+ * All durations are measured in nanoseconds. The source images are prepared on several
+ * threads, so loadTime and conversionTime are summed over all threads and can exceed the
+ * wall time of flush(). The same applies to encodeTime with the ItemLayout layout, where the
+ * images are encoded on the worker threads.
+ *
+ * \list
+ * \li loadTime is the time spent loading the source images;
+ * \li conversionTime is the time spent scaling images and converting them from RGB to YUV;
+ * \li encodeTime is the time spent encoding AV1 frames;
+ * \li writeTime is the time spent writing the output device;
+ * \li bytesWritten is the number of bytes written to the output device;
+ * \li encodedImageCount is the number of encoded wallpaper images, thumbnails excluded;
+ * \li cachedImageCount is the number of wallpaper images taken from the item cache rather
+ * than encoded.
+ * \endlist
+ *
+ * The same numbers are logged to the \c kdynamicwallpaper logging category at the debug level.
+ */
+
+/*!
+ * Returns the statistics of the last flush().
+ */
+KDynamicWallpaperWriter::Statistics KDynamicWallpaperWriter::statistics() const
+{
+    return d->statistics;
+}
+
 /*!
  * Returns the type of the last error that occurred.
  */
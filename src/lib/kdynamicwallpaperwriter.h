@@ -11,9 +11,12 @@
 
 #include <QIODevice>
 #include <QImage>
+#include <QSharedDataPointer>
 
+#include <functional>
 #include <optional>
 
+class KDynamicWallpaperImageViewPrivate;
 class KDynamicWallpaperWriterPrivate;
 
 class KDYNAMICWALLPAPER_EXPORT KDynamicWallpaperWriter
@@ -26,26 +29,61 @@ public:
         UnknownError,
     };
 
-    class ImageView
+    enum PixelFormat {
+        Yuv444Format,
+        Yuv422Format,
+        Yuv420Format,
+    };
+
+    enum YuvRange {
+        FullRange,
+        LimitedRange,
+    };
+
+    enum Layout {
+        SequenceLayout,
+        ItemLayout,
+    };
+
+    struct Statistics
+    {
+        qint64 loadTime = 0;
+        qint64 conversionTime = 0;
+        qint64 encodeTime = 0;
+        qint64 writeTime = 0;
+        qint64 bytesWritten = 0;
+        int encodedImageCount = 0;
+        int cachedImageCount = 0;
+    };
+
+    class ItemCache
+    {
+    public:
+        virtual ~ItemCache() = default;
+
+        virtual QByteArray find(const QByteArray &key) = 0;
+        virtual void insert(const QByteArray &key, const QByteArray &item) = 0;
+    };
+
+    class KDYNAMICWALLPAPER_EXPORT ImageView
     {
     public:
-        explicit ImageView(const QString &fileName)
-            : m_fileName(fileName)
-        {
-        }
+        using Generator = std::function<QImage()>;
 
-        QImage data() const
-        {
-            return QImage(m_fileName);
-        }
+        explicit ImageView(const QString &fileName);
+        explicit ImageView(const QImage &image, const QString &key = QString());
+        ImageView(QIODevice *device, const QString &key);
+        ImageView(const Generator &generator, const QString &key);
+        ImageView(const ImageView &other);
+        ~ImageView();
 
-        QString key() const
-        {
-            return m_fileName;
-        }
+        ImageView &operator=(const ImageView &other);
+
+        QImage data() const;
+        QString key() const;
 
     private:
-        QString m_fileName;
+        QSharedDataPointer<KDynamicWallpaperImageViewPrivate> d;
     };
 
     KDynamicWallpaperWriter();
@@ -54,6 +92,24 @@ public:
     void setSpeed(int speed);
     std::optional<int> speed() const;
 
+    void setQuality(int quality);
+    std::optional<int> quality() const;
+
+    void setMinQuantizer(int quantizer);
+    std::optional<int> minQuantizer() const;
+
+    void setMaxQuantizer(int quantizer);
+    std::optional<int> maxQuantizer() const;
+
+    void setPixelFormat(PixelFormat format);
+    PixelFormat pixelFormat() const;
+
+    void setBitDepth(int depth);
+    int bitDepth() const;
+
+    void setYuvRange(YuvRange range);
+    YuvRange yuvRange() const;
+
     void setMetaData(const QList<KDynamicWallpaperMetaData> &metaData);
     QList<KDynamicWallpaperMetaData> metaData() const;
 
@@ -69,6 +125,35 @@ public:
     void setMaxThreadCount(int max);
     std::optional<int> maxThreadCount() const;
 
+    void setLayout(Layout layout);
+    Layout layout() const;
+
+    void setKeyframeInterval(int interval);
+    std::optional<int> keyframeInterval() const;
+
+    void setAllIntra(bool allIntra);
+    bool isAllIntra() const;
+
+    void setTileRowsLog2(int rows);
+    std::optional<int> tileRowsLog2() const;
+
+    void setTileColumnsLog2(int columns);
+    std::optional<int> tileColumnsLog2() const;
+
+    void setAutoTiling(bool enabled);
+    bool autoTiling() const;
+
+    void setItemCache(ItemCache *cache);
+    ItemCache *itemCache() const;
+
+    void setMaxInFlightImageCount(int max);
+    std::optional<int> maxInFlightImageCount() const;
+
+    void setThumbnailSize(const QSize &size);
+    QSize thumbnailSize() const;
+
+    Statistics statistics() const;
+
     WallpaperWriterError error() const;
     QString errorString() const;
 
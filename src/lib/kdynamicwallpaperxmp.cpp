@@ -0,0 +1,58 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#include "kdynamicwallpaperxmp_p.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QXmlStreamReader>
+
+template<typename T>
+static QList<KDynamicWallpaperMetaData> parseMetaDataArray(const QByteArray &base64)
+{
+    const QJsonArray array = QJsonDocument::fromJson(QByteArray::fromBase64(base64)).array();
+
+    QList<KDynamicWallpaperMetaData> result;
+    result.reserve(array.size());
+    for (int i = 0; i < array.size(); ++i) {
+        T metaData = T::fromJson(array[i].toObject());
+        if (metaData.isValid())
+            result.append(metaData);
+    }
+    return result;
+}
+
+/*!
+ * Parses the metadata in the specified \a xmp packet. The packet is scanned in a single pass
+ * until an rdf:Description element with either the solar or the day-night attribute is found.
+ */
+QList<KDynamicWallpaperMetaData> KDynamicWallpaperXmp::parse(const QByteArray &xmp)
+{
+    QXmlStreamReader reader(xmp);
+
+    while (!reader.atEnd()) {
+        if (reader.readNext() != QXmlStreamReader::StartElement)
+            continue;
+        if (reader.qualifiedName() != QLatin1String("rdf:Description"))
+            continue;
+
+        const QXmlStreamAttributes attributes = reader.attributes();
+        for (const QXmlStreamAttribute &attribute : attributes) {
+            const QStringView name = attribute.qualifiedName();
+            if (name == QLatin1String("plasma:dynamic-wallpaper-solar")) {
+                const QByteArray base64 = attribute.value().toLatin1();
+                if (!base64.isEmpty())
+                    return parseMetaDataArray<KSolarDynamicWallpaperMetaData>(base64);
+            } else if (name == QLatin1String("plasma:dynamic-wallpaper-day-night")) {
+                const QByteArray base64 = attribute.value().toLatin1();
+                if (!base64.isEmpty())
+                    return parseMetaDataArray<KDayNightDynamicWallpaperMetaData>(base64);
+            }
+        }
+    }
+
+    return QList<KDynamicWallpaperMetaData>();
+}
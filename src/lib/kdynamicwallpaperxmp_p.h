@@ -0,0 +1,18 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: LGPL-3.0-or-later
+ */
+
+#pragma once
+
+#include "kdynamicwallpapermetadata.h"
+
+#include <QByteArray>
+#include <QList>
+
+class KDynamicWallpaperXmp
+{
+public:
+    static QList<KDynamicWallpaperMetaData> parse(const QByteArray &xmp);
+};
@@ -11,3 +11,17 @@ complete -c kdynamicwallpaperbuilder -l help-all -d "Show help message including
 
 complete -c kdynamicwallpaperbuilder -l output -d "Specify the file where the output will be written" -r
 complete -c kdynamicwallpaperbuilder -l max-threads -d "Maximum number of threads that can be used when encoding a wallpaper" -r
+complete -c kdynamicwallpaperbuilder -l quality -d "Encoding quality, 0 - worst, 100 - lossless" -r
+complete -c kdynamicwallpaperbuilder -l min-quantizer -d "Lowest quantizer, 0 - lossless, 63 - worst" -r
+complete -c kdynamicwallpaperbuilder -l max-quantizer -d "Highest quantizer, 0 - lossless, 63 - worst" -r
+complete -c kdynamicwallpaperbuilder -l pixel-format -d "Chroma subsampling of the encoded images" -x -a "444 422 420"
+complete -c kdynamicwallpaperbuilder -l depth -d "Number of bits per sample" -x -a "8 10 12"
+complete -c kdynamicwallpaperbuilder -l yuv-range -d "Range of the YUV samples" -x -a "full limited"
+complete -c kdynamicwallpaperbuilder -l thumbnail-size -d "Embed thumbnails no larger than the specified size in pixels" -r
+complete -c kdynamicwallpaperbuilder -l tile-rows-log2 -d "Base 2 logarithm of the number of tile rows, 0 - 6" -r
+complete -c kdynamicwallpaperbuilder -l tile-cols-log2 -d "Base 2 logarithm of the number of tile columns, 0 - 6" -r
+complete -c kdynamicwallpaperbuilder -l auto-tiling -d "Choose the number of tiles based on the image size"
+complete -c kdynamicwallpaperbuilder -l layout -d "Store images as an image sequence or as independent images" -x -a "sequence item"
+complete -c kdynamicwallpaperbuilder -l cache-dir -d "Reuse images encoded by previous builds, requires the item layout" -x -a "(__fish_complete_directories)"
+complete -c kdynamicwallpaperbuilder -l keyframe-interval -d "Maximum number of images between two keyframes" -r
+complete -c kdynamicwallpaperbuilder -l all-intra -d "Encode every image as a keyframe"
@@ -0,0 +1,52 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "dynamicwallpaperencodecache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+
+/*!
+ * \class DynamicWallpaperEncodeCache
+ * \brief The DynamicWallpaperEncodeCache class stores encoded wallpaper images in a directory.
+ *
+ * Every encoded image is stored in its own file named after the key of the image, so the
+ * cache can be shared by several wallpapers and cleaned up by simply removing the directory.
+ */
+
+/*!
+ * Constructs an encode cache that stores the encoded images in the specified \a directory.
+ */
+DynamicWallpaperEncodeCache::DynamicWallpaperEncodeCache(const QString &directory)
+    : m_directory(directory)
+{
+    QDir().mkpath(m_directory);
+}
+
+QString DynamicWallpaperEncodeCache::filePath(const QByteArray &key) const
+{
+    return m_directory + QLatin1Char('/') + QString::fromLatin1(key) + QLatin1String(".avif");
+}
+
+QByteArray DynamicWallpaperEncodeCache::find(const QByteArray &key)
+{
+    QFile file(filePath(key));
+    if (!file.open(QFile::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+
+void DynamicWallpaperEncodeCache::insert(const QByteArray &key, const QByteArray &item)
+{
+    // The item is written to a temporary file first, so an interrupted build can't leave a
+    // truncated item behind.
+    QSaveFile file(filePath(key));
+    if (!file.open(QFile::WriteOnly))
+        return;
+    file.write(item);
+    file.commit();
+}
@@ -0,0 +1,25 @@
+/*
+ * SPDX-FileCopyrightText: 2020 Vlad Zahorodnii <vlad.zahorodnii@kde.org>
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <KDynamicWallpaperWriter>
+
+#include <QString>
+
+class DynamicWallpaperEncodeCache : public KDynamicWallpaperWriter::ItemCache
+{
+public:
+    explicit DynamicWallpaperEncodeCache(const QString &directory);
+
+    QByteArray find(const QByteArray &key) override;
+    void insert(const QByteArray &key, const QByteArray &item) override;
+
+private:
+    QString filePath(const QByteArray &key) const;
+
+    QString m_directory;
+};
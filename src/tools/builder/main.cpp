@@ -15,6 +15,9 @@
 #include <KLocalizedString>
 #include <KSolarDynamicWallpaperMetaData>
 
+#include <memory>
+
+#include "dynamicwallpaperencodecache.h"
 #include "dynamicwallpapermanifest.h"
 
 int main(int argc, char **argv)
@@ -31,10 +34,64 @@ int main(int argc, char **argv)
     speedOption.setDescription(i18n("Encoding speed, 0 - slowest, 10 - fastest"));
     speedOption.setValueName(QStringLiteral("speed"));
 
+    QCommandLineOption qualityOption(QStringLiteral("quality"));
+    qualityOption.setDescription(i18n("Encoding quality, 0 - worst, 100 - lossless"));
+    qualityOption.setValueName(QStringLiteral("quality"));
+
+    QCommandLineOption minQuantizerOption(QStringLiteral("min-quantizer"));
+    minQuantizerOption.setDescription(i18n("Lowest quantizer, 0 - lossless, 63 - worst"));
+    minQuantizerOption.setValueName(QStringLiteral("quantizer"));
+
+    QCommandLineOption maxQuantizerOption(QStringLiteral("max-quantizer"));
+    maxQuantizerOption.setDescription(i18n("Highest quantizer, 0 - lossless, 63 - worst"));
+    maxQuantizerOption.setValueName(QStringLiteral("quantizer"));
+
+    QCommandLineOption pixelFormatOption(QStringLiteral("pixel-format"));
+    pixelFormatOption.setDescription(i18n("Chroma subsampling of the encoded images (444|422|420)"));
+    pixelFormatOption.setValueName(QStringLiteral("format"));
+
+    QCommandLineOption depthOption(QStringLiteral("depth"));
+    depthOption.setDescription(i18n("Number of bits per sample (8|10|12)"));
+    depthOption.setValueName(QStringLiteral("depth"));
+
+    QCommandLineOption yuvRangeOption(QStringLiteral("yuv-range"));
+    yuvRangeOption.setDescription(i18n("Range of the YUV samples (full|limited)"));
+    yuvRangeOption.setValueName(QStringLiteral("range"));
+
     QCommandLineOption maxThreadsOption(QStringLiteral("max-threads"));
     maxThreadsOption.setDescription(i18n("Maximum number of threads that can be used when encoding a wallpaper"));
     maxThreadsOption.setValueName(QStringLiteral("max-threads"));
 
+    QCommandLineOption thumbnailSizeOption(QStringLiteral("thumbnail-size"));
+    thumbnailSizeOption.setDescription(i18n("Embed thumbnails no larger than <size>x<size> pixels"));
+    thumbnailSizeOption.setValueName(QStringLiteral("size"));
+
+    QCommandLineOption cacheDirOption(QStringLiteral("cache-dir"));
+    cacheDirOption.setDescription(i18n("Reuse images encoded by previous builds stored in <directory>, requires the item layout; with the sequence layout every image is encoded again"));
+    cacheDirOption.setValueName(QStringLiteral("directory"));
+
+    QCommandLineOption tileRowsOption(QStringLiteral("tile-rows-log2"));
+    tileRowsOption.setDescription(i18n("Base 2 logarithm of the number of tile rows, 0 - 6"));
+    tileRowsOption.setValueName(QStringLiteral("rows"));
+
+    QCommandLineOption tileColumnsOption(QStringLiteral("tile-cols-log2"));
+    tileColumnsOption.setDescription(i18n("Base 2 logarithm of the number of tile columns, 0 - 6"));
+    tileColumnsOption.setValueName(QStringLiteral("columns"));
+
+    QCommandLineOption autoTilingOption(QStringLiteral("auto-tiling"));
+    autoTilingOption.setDescription(i18n("Choose the number of tiles based on the image size"));
+
+    QCommandLineOption layoutOption(QStringLiteral("layout"));
+    layoutOption.setDescription(i18n("Store images as an image sequence or as independent images (sequence|item)"));
+    layoutOption.setValueName(QStringLiteral("layout"));
+
+    QCommandLineOption keyframeIntervalOption(QStringLiteral("keyframe-interval"));
+    keyframeIntervalOption.setDescription(i18n("Maximum number of images between two keyframes"));
+    keyframeIntervalOption.setValueName(QStringLiteral("interval"));
+
+    QCommandLineOption allIntraOption(QStringLiteral("all-intra"));
+    allIntraOption.setDescription(i18n("Encode every image as a keyframe"));
+
     QCommandLineOption codecOption(QStringLiteral("codec"));
     codecOption.setDescription(i18n("Codec to use (aom|rav1e|svt)"));
     codecOption.setValueName(QStringLiteral("codec"));
@@ -49,7 +106,21 @@ int main(int argc, char **argv)
     parser.addOption(outputOption);
     parser.addOption(maxThreadsOption);
     parser.addOption(speedOption);
+    parser.addOption(qualityOption);
+    parser.addOption(minQuantizerOption);
+    parser.addOption(maxQuantizerOption);
+    parser.addOption(pixelFormatOption);
+    parser.addOption(depthOption);
+    parser.addOption(yuvRangeOption);
     parser.addOption(codecOption);
+    parser.addOption(thumbnailSizeOption);
+    parser.addOption(tileRowsOption);
+    parser.addOption(tileColumnsOption);
+    parser.addOption(autoTilingOption);
+    parser.addOption(layoutOption);
+    parser.addOption(cacheDirOption);
+    parser.addOption(keyframeIntervalOption);
+    parser.addOption(allIntraOption);
     parser.addOption(verboseOption);
     parser.process(app);
 
@@ -108,6 +179,117 @@ int main(int argc, char **argv)
         }
     }
 
+    if (parser.isSet(qualityOption)) {
+        bool ok;
+        if (const int quality = parser.value(qualityOption).toInt(&ok); ok) {
+            writer.setQuality(quality);
+        } else {
+            parser.showHelp(-1);
+        }
+    }
+
+    if (parser.isSet(minQuantizerOption)) {
+        bool ok;
+        if (const int quantizer = parser.value(minQuantizerOption).toInt(&ok); ok) {
+            writer.setMinQuantizer(quantizer);
+        } else {
+            parser.showHelp(-1);
+        }
+    }
+
+    if (parser.isSet(maxQuantizerOption)) {
+        bool ok;
+        if (const int quantizer = parser.value(maxQuantizerOption).toInt(&ok); ok) {
+            writer.setMaxQuantizer(quantizer);
+        } else {
+            parser.showHelp(-1);
+        }
+    }
+
+    if (parser.isSet(pixelFormatOption)) {
+        const QString pixelFormat = parser.value(pixelFormatOption);
+        if (pixelFormat == QLatin1String("444")) {
+            writer.setPixelFormat(KDynamicWallpaperWriter::Yuv444Format);
+        } else if (pixelFormat == QLatin1String("422")) {
+            writer.setPixelFormat(KDynamicWallpaperWriter::Yuv422Format);
+        } else if (pixelFormat == QLatin1String("420")) {
+            writer.setPixelFormat(KDynamicWallpaperWriter::Yuv420Format);
+        } else {
+            parser.showHelp(-1);
+        }
+    }
+
+    if (parser.isSet(depthOption)) {
+        bool ok;
+        if (const int depth = parser.value(depthOption).toInt(&ok); ok && (depth == 8 || depth == 10 || depth == 12)) {
+            writer.setBitDepth(depth);
+        } else {
+            parser.showHelp(-1);
+        }
+    }
+
+    if (parser.isSet(yuvRangeOption)) {
+        const QString yuvRange = parser.value(yuvRangeOption);
+        if (yuvRange == QLatin1String("full")) {
+            writer.setYuvRange(KDynamicWallpaperWriter::FullRange);
+        } else if (yuvRange == QLatin1String("limited")) {
+            writer.setYuvRange(KDynamicWallpaperWriter::LimitedRange);
+        } else {
+            parser.showHelp(-1);
+        }
+    }
+
+    if (parser.isSet(thumbnailSizeOption)) {
+        bool ok;
+        if (const int thumbnailSize = parser.value(thumbnailSizeOption).toInt(&ok); ok && thumbnailSize > 0) {
+            writer.setThumbnailSize(QSize(thumbnailSize, thumbnailSize));
+        } else {
+            parser.showHelp(-1);
+        }
+    }
+
+    if (parser.isSet(tileRowsOption)) {
+        bool ok;
+        if (const int rows = parser.value(tileRowsOption).toInt(&ok); ok) {
+            writer.setTileRowsLog2(rows);
+        } else {
+            parser.showHelp(-1);
+        }
+    }
+
+    if (parser.isSet(tileColumnsOption)) {
+        bool ok;
+        if (const int columns = parser.value(tileColumnsOption).toInt(&ok); ok) {
+            writer.setTileColumnsLog2(columns);
+        } else {
+            parser.showHelp(-1);
+        }
+    }
+
+    writer.setAutoTiling(parser.isSet(autoTilingOption));
+
+    if (parser.isSet(layoutOption)) {
+        const QString layout = parser.value(layoutOption);
+        if (layout == QLatin1String("sequence")) {
+            writer.setLayout(KDynamicWallpaperWriter::SequenceLayout);
+        } else if (layout == QLatin1String("item")) {
+            writer.setLayout(KDynamicWallpaperWriter::ItemLayout);
+        } else {
+            parser.showHelp(-1);
+        }
+    }
+
+    if (parser.isSet(keyframeIntervalOption)) {
+        bool ok;
+        if (const int keyframeInterval = parser.value(keyframeIntervalOption).toInt(&ok); ok && keyframeInterval >= 0) {
+            writer.setKeyframeInterval(keyframeInterval);
+        } else {
+            parser.showHelp(-1);
+        }
+    }
+
+    writer.setAllIntra(parser.isSet(allIntraOption));
+
     if (parser.isSet(codecOption)) {
         if (!writer.setCodecName(parser.value(codecOption))) {
             qWarning() << qPrintable(writer.errorString());
@@ -115,6 +297,14 @@ int main(int argc, char **argv)
         }
     }
 
+    std::unique_ptr<DynamicWallpaperEncodeCache> encodeCache;
+    if (parser.isSet(cacheDirOption)) {
+        if (writer.layout() != KDynamicWallpaperWriter::ItemLayout)
+            qWarning() << "The encode cache is only used with the item layout";
+        encodeCache = std::make_unique<DynamicWallpaperEncodeCache>(parser.value(cacheDirOption));
+        writer.setItemCache(encodeCache.get());
+    }
+
     QString targetFileName = parser.value(outputOption);
     if (targetFileName.isEmpty())
         targetFileName = QStringLiteral("wallpaper.avif");
@@ -125,5 +315,10 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    if (parser.isSet(verboseOption)) {
+        const KDynamicWallpaperWriter::Statistics statistics = writer.statistics();
+        qDebug("Encoded %d images, reused %d images", statistics.encodedImageCount, statistics.cachedImageCount);
+    }
+
     return 0;
 }